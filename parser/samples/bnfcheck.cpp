@@ -18,7 +18,11 @@
  */
 
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <cstdio>
 
 #include <SimpleOpt.h>
 
@@ -48,6 +52,107 @@ public:
   }
 };
 
+static const char *limit_name(BnfParser2::ResultCode code)
+{
+  switch(code)
+  {
+    case BnfParser2::Result_ReductionLimit:
+      return "reductions";
+    case BnfParser2::Result_NodeLimit:
+      return "nodes";
+    case BnfParser2::Result_EdgeLimit:
+      return "edges";
+    case BnfParser2::Result_SemanticLimit:
+      return "semantic";
+    case BnfParser2::Result_TimeLimit:
+      return "time";
+    default:
+      return "unknown";
+  }
+}
+
+//! Reads the whole standard input
+static void read_input(std::string& input)
+{
+  char block[65536];
+  size_t count;
+  while((count = fread(block, 1, sizeof(block), stdin)) > 0)
+    input.append(block, count);
+}
+
+//! Finds the next word of the input, the words are separated by the delimiter
+/** Returns false after the last word. The word is not copied, it points
+ *  to the input. A delimiter at the end of the input is followed by an
+ *  empty word.
+ */
+static bool next_word(const std::string& input, int delimiter, size_t& begin,
+  const char *&word, size_t& length)
+{
+  if(begin > input.size())
+    return false;
+
+  size_t end = input.find(static_cast<char>(delimiter), begin);
+  if(end == std::string::npos)
+    end = input.size();
+
+  word = input.data() + begin;
+  length = end - begin;
+  begin = end + 1;
+  return true;
+}
+
+//! Orders the rules by their work, the costliest first
+static bool more_rule_work(const BnfRuleProfile& first, const BnfRuleProfile& second)
+{
+  return first.reductions + first.path_steps > second.reductions + second.path_steps;
+}
+
+//! Orders the states by their splits, the most first
+static bool more_splits(const BnfStateProfile& first, const BnfStateProfile& second)
+{
+  return first.splits > second.splits;
+}
+
+//! Prints the given number of the costliest rules and states of all the words parsed
+static void print_profile(BnfParser2& test, unsigned count)
+{
+  BnfProfile profile;
+  test.get_profile(profile);
+
+  std::stable_sort(profile.rules.begin(), profile.rules.end(), more_rule_work);
+  for(unsigned k = 0; k < profile.rules.size() && k < count; k++)
+  {
+    const BnfRuleProfile& rule = profile.rules[k];
+    std::cout << "profile: " << rule.reductions << " reductions, " << rule.path_steps
+      << " path steps in " << (rule.nonterminal.empty() ? "?" : rule.nonterminal.c_str());
+    if(!rule.grammar.empty())
+      std::cout << " (" << rule.grammar << ")";
+    std::cout << ": " << rule.rule << std::endl;
+  }
+
+  std::stable_sort(profile.states.begin(), profile.states.end(), more_splits);
+  for(unsigned k = 0; k < profile.states.size() && k < count; k++)
+  {
+    const BnfStateProfile& state = profile.states[k];
+    std::cout << "profile: " << state.splits << " splits in state " << state.state;
+    for(unsigned l = 0; l < state.rules.size(); l++)
+      std::cout << (l == 0 ? ": " : " | ") << state.rules[l];
+    std::cout << std::endl;
+  }
+}
+
+//! The number of the last events written by --events
+static const unsigned event_capacity = 65536;
+
+//! Prints the profile and writes the events, if requested
+static void write_reports(BnfParser2& test, unsigned profile, const char *events)
+{
+  if(profile > 0)
+    print_profile(test, profile);
+  if(events != NULL && !test.write_events(events))
+    std::cerr << "Cannot write the events to " << events << std::endl;
+}
+
 int main(int argc, char  *argv[])
 {
   // instantiate the parser
@@ -57,7 +162,17 @@ int main(int argc, char  *argv[])
   test.set_reporter(&reporter);
 
   int delimiter = '\n';
+  unsigned batch = 0;
+  bool search = false;
+  const char *target = NULL;
+  bool fields = false;
+  bool recovery = false;
+  bool stats = false;
+  unsigned profile = 0;
+  const char *events = NULL;
   bool automatic_includes = true;
+  bool rebuild = false;
+  BnfLimits limits;
 #ifdef DATADIR
   test.add_search_path(DATADIR);
 #endif
@@ -65,8 +180,22 @@ int main(int argc, char  *argv[])
   enum
   {
     OPT_DIRECTORY,
+    OPT_CACHE,
     OPT_DELIMITER,
     OPT_MANUAL_INCLUDES,
+    OPT_REBUILD,
+    OPT_LIMIT,
+    OPT_AMBIGUITY,
+    OPT_BATCH,
+    OPT_PREFILTER,
+    OPT_MATCH,
+    OPT_SEARCH,
+    OPT_TARGET,
+    OPT_FIELD,
+    OPT_RECOVER,
+    OPT_STATS,
+    OPT_PROFILE,
+    OPT_EVENTS,
     OPT_VERBOSE,
     OPT_HELP
   };
@@ -74,9 +203,32 @@ int main(int argc, char  *argv[])
   static CSimpleOpt::SOption const long_options[] =
   {
     { OPT_DIRECTORY, "-d", SO_REQ_SEP },
+    { OPT_CACHE, "-c", SO_REQ_SEP },
+    { OPT_CACHE, "--cache", SO_REQ_CMB },
     { OPT_DELIMITER, "-e", SO_REQ_SEP },
     { OPT_DELIMITER, "--delimiter", SO_REQ_CMB },
     { OPT_MANUAL_INCLUDES, "--manual-includes", SO_NONE },
+    { OPT_REBUILD, "--rebuild", SO_NONE },
+    { OPT_LIMIT, "-l", SO_REQ_SEP },
+    { OPT_LIMIT, "--limit", SO_REQ_CMB },
+    { OPT_AMBIGUITY, "-a", SO_REQ_SEP },
+    { OPT_AMBIGUITY, "--ambiguity", SO_REQ_CMB },
+    { OPT_BATCH, "-b", SO_REQ_SEP },
+    { OPT_BATCH, "--batch", SO_REQ_CMB },
+    { OPT_PREFILTER, "--prefilter", SO_NONE },
+    { OPT_MATCH, "-m", SO_REQ_SEP },
+    { OPT_MATCH, "--match", SO_REQ_CMB },
+    { OPT_SEARCH, "-s", SO_NONE },
+    { OPT_SEARCH, "--search", SO_NONE },
+    { OPT_TARGET, "-t", SO_REQ_SEP },
+    { OPT_TARGET, "--target", SO_REQ_CMB },
+    { OPT_FIELD, "-f", SO_REQ_SEP },
+    { OPT_FIELD, "--field", SO_REQ_CMB },
+    { OPT_RECOVER, "-r", SO_REQ_SEP },
+    { OPT_RECOVER, "--recover", SO_REQ_CMB },
+    { OPT_STATS, "--stats", SO_NONE },
+    { OPT_PROFILE, "--profile", SO_REQ_CMB },
+    { OPT_EVENTS, "--events", SO_REQ_CMB },
     { OPT_VERBOSE, "-v", SO_REQ_SEP },
     { OPT_VERBOSE, "--verbose", SO_REQ_CMB },
     { OPT_HELP, "--help", SO_NONE },
@@ -90,7 +242,7 @@ int main(int argc, char  *argv[])
   {
     if(args.LastError() != SO_SUCCESS)
     {
-      printf( "Usage: %s [OPTION]... SYMBOL ([:[VARIANT]] SYNTAX)...\n", argv[0] );
+      printf( "Usage: %s [OPTION]... SYMBOL[,SYMBOL]... ([:[VARIANT]] SYNTAX)...\n", argv[0] );
       fprintf( stderr, "Try '%s --help' for more information.\n", argv[0] );
       exit(1);
     }
@@ -100,29 +252,171 @@ int main(int argc, char  *argv[])
       case OPT_DIRECTORY:
         test.add_search_path(args.OptionArg());
         break;
+      case OPT_CACHE:
+        test.set_cache_directory(args.OptionArg());
+        break;
       case OPT_DELIMITER:
         delimiter = atol(args.OptionArg());
         break;
       case OPT_MANUAL_INCLUDES:
         automatic_includes = false;
         break;
+      case OPT_REBUILD:
+        rebuild = true;
+        break;
+      case OPT_LIMIT:
+      {
+        const char *value = strchr(args.OptionArg(), '=');
+        size_t name_length = value ? value - args.OptionArg() : 0;
+        unsigned long *limit = NULL;
+
+        if(name_length > 0 && strncmp(args.OptionArg(), "reductions", name_length) == 0)
+          limit = &limits.max_reductions;
+        else if(name_length > 0 && strncmp(args.OptionArg(), "nodes", name_length) == 0)
+          limit = &limits.max_nodes;
+        else if(name_length > 0 && strncmp(args.OptionArg(), "edges", name_length) == 0)
+          limit = &limits.max_edges;
+        else if(name_length > 0 && strncmp(args.OptionArg(), "semantic", name_length) == 0)
+          limit = &limits.max_semantic_bytes;
+        else if(name_length > 0 && strncmp(args.OptionArg(), "time", name_length) == 0)
+          limit = &limits.max_time;
+        else
+        {
+          std::cerr << argv[0] << ": unknown limit " << args.OptionArg() << std::endl;
+          exit(1);
+        }
+        *limit = strtoul(value+1, NULL, 10);
+        break;
+      }
+      case OPT_AMBIGUITY:
+        if(strcmp(args.OptionArg(), "all") == 0)
+          test.set_ambiguity_policy(BnfParser2::Ambiguity_KeepAll);
+        else if(strcmp(args.OptionArg(), "first") == 0)
+          test.set_ambiguity_policy(BnfParser2::Ambiguity_KeepFirst);
+        else if(strcmp(args.OptionArg(), "rule") == 0)
+          test.set_ambiguity_policy(BnfParser2::Ambiguity_PreferRule);
+        else if(atol(args.OptionArg()) > 0)
+          test.set_ambiguity_policy(BnfParser2::Ambiguity_KeepN, atol(args.OptionArg()));
+        else
+        {
+          std::cerr << argv[0] << ": unknown ambiguity policy " << args.OptionArg() << std::endl;
+          exit(1);
+        }
+        break;
+      case OPT_BATCH:
+        batch = strtoul(args.OptionArg(), NULL, 10);
+        break;
+      case OPT_PREFILTER:
+        test.set_prefilter(true);
+        break;
+      case OPT_MATCH:
+        if(strcmp(args.OptionArg(), "whole") == 0)
+          test.set_match_mode(BnfParser2::Match_Whole);
+        else if(strcmp(args.OptionArg(), "longest") == 0)
+          test.set_match_mode(BnfParser2::Match_Longest);
+        else if(strcmp(args.OptionArg(), "shortest") == 0)
+          test.set_match_mode(BnfParser2::Match_Shortest);
+        else
+        {
+          std::cerr << argv[0] << ": unknown match mode " << args.OptionArg() << std::endl;
+          exit(1);
+        }
+        break;
+      case OPT_SEARCH:
+        search = true;
+        break;
+      case OPT_TARGET:
+        target = args.OptionArg();
+        break;
+      case OPT_FIELD:
+        test.add_field(args.OptionArg());
+        fields = true;
+        break;
+      case OPT_RECOVER:
+      {
+        // the terminator is CRLF unless given, with the \r, \n and \t escapes
+        std::string symbol = args.OptionArg();
+        std::string terminator = "\r\n";
+        size_t value = symbol.find('=');
+        if(value != std::string::npos)
+        {
+          terminator.clear();
+          for(size_t k = value + 1; k < symbol.size(); k++)
+          {
+            if(symbol[k] == '\\' && k + 1 < symbol.size())
+            {
+              k++;
+              terminator += (symbol[k] == 'r') ? '\r' : (symbol[k] == 'n') ? '\n'
+                : (symbol[k] == 't') ? '\t' : symbol[k];
+            }
+            else
+              terminator += symbol[k];
+          }
+          symbol.erase(value);
+        }
+        test.add_recovery_symbol(symbol.c_str(), terminator.c_str());
+        recovery = true;
+        break;
+      }
+      case OPT_STATS:
+        stats = true;
+        break;
+      case OPT_PROFILE:
+        profile = atol(args.OptionArg());
+        test.set_profiling(profile > 0);
+        break;
+      case OPT_EVENTS:
+        events = args.OptionArg();
+        test.set_event_recording(event_capacity);
+        break;
       case OPT_VERBOSE:
         test.set_verbose_level( atol(args.OptionArg()) );
         break;
 
       case OPT_HELP:
         printf(
-"Usage: %s [OPTION]... SYMBOL ([:[VARIANT]] SYNTAX)...\n"
+"Usage: %s [OPTION]... SYMBOL[,SYMBOL]... ([:[VARIANT]] SYNTAX)...\n"
 "Check input against a BNF syntax specification.\n"
 "\n"
 "  -d DIR                    search specifications in the directory DIR\n"
+"  -c DIR, --cache=DIR       cache compiled grammars in the directory DIR\n"
 "  -e NUM, --delimiter=NUM   set word delimiter to NUM (default %i in ASCII)\n"
 "  --manual-includes         do not automatically load referenced grammars\n"
-"  -v LEVEL, --verbose=LEVEL set verbosity to LEVEL (default %i)\n"
+"  --rebuild                 build the parser and parse the first word before\n"
+"                            the referenced grammars are loaded, then build it\n"
+"                            again, to check the incremental rebuild\n"
+"  -l NAME=NUM, --limit=NAME=NUM\n"
+"                            stop parsing a word when the limit is exceeded, NAME\n"
+"                            is reductions, nodes, edges, semantic or time (ms)\n"
+"  -a POLICY, --ambiguity=POLICY\n"
+"                            keep all, first, NUM or rule (by the alternative\n"
+"                            given first) derivations of ambiguous input\n"
+"  -b NUM, --batch=NUM       parse NUM words at once, print the results only\n"
+"  --prefilter               reject the words failing the checks derived from\n"
+"                            the grammar without parsing\n"
+"  -m MODE, --match=MODE     accept the whole word (default), or its longest\n"
+"                            or shortest prefix\n"
+"  -s, --search              find the parts of the input the symbol generates\n"
+"  -t SYMBOL, --target=SYMBOL\n"
+"                            accept the words SYMBOL generates, one of the\n"
+"                            comma separated start symbols\n"
+"  -f NAME, --field=NAME     print the positions of the marked nonterminal NAME\n"
+"                            in the accepted words, may be repeated\n"
+"  -r SYMBOL[=END], --recover=SYMBOL[=END]\n"
+"                            after an error skip to the END of SYMBOL (default\n"
+"                            \\r\\n) and continue, report all errors of a word\n"
+"  --stats                   print the statistics of the parsing of each word\n"
+"  --profile=NUM             print the NUM costliest rules and parser states\n"
+"                            of all the words\n"
+"  --events=FILE             write the last %u events of the parsing to FILE,\n"
+"                            see bnfevents\n"
+"  -v LEVEL, --verbose=LEVEL set verbosity to LEVEL (default %i), the levels\n"
+"                            above 6 (8 if configured with --enable-debug, or\n"
+"                            set by --with-max-log-level) are compiled out\n"
 "  --help                    display this help and exit\n"
 "\n"
 "Report bugs to <"PACKAGE_BUGREPORT">.\n",
-          argv[0], delimiter, test.get_verbose_level()
+          argv[0], delimiter, event_capacity, test.get_verbose_level()
         );
         exit(0);
     }
@@ -135,7 +429,16 @@ int main(int argc, char  *argv[])
     return 1;
   }
 
-  const char* symbol = args.File(fileind++);
+  // several start symbols are separated by commas
+  std::vector<std::string> symbols;
+  std::string symbol_list = args.File(fileind++);
+  for(size_t pos = 0, next; pos <= symbol_list.size(); pos = next + 1)
+  {
+    next = symbol_list.find(',', pos);
+    if(next == std::string::npos)
+      next = symbol_list.size();
+    symbols.push_back(symbol_list.substr(pos, next - pos));
+  }
 
   const char* variant = NULL;
   const char* last_variant = NULL;
@@ -164,7 +467,9 @@ int main(int argc, char  *argv[])
   }
 
   // load start grammar
-  test.set_start_symbol(symbol, param);
+  test.set_start_symbol(symbols[0].c_str(), param);
+  for(unsigned k = 1; k < symbols.size(); k++)
+    test.add_start_symbol(symbols[k].c_str(), param);
   test.add_grammar(param, variant);
   // load next grammars
   while(fileind > args.FileCount())
@@ -193,10 +498,28 @@ int main(int argc, char  *argv[])
     }
   }
 
+  // the words are parsed in place, note: separated by the delimiter, terminated by EOF
+  std::string input;
+  read_input(input);
+  size_t begin = 0;
+  const char *word;
+  size_t length;
+
+  if(rebuild)
+  {
+    // the result is not printed, the words are parsed again after the rebuild
+    test.build_parser();
+    if(next_word(input, delimiter, begin, word, length))
+      test.parse(word, length);
+    begin = 0;
+  }
+
   if(automatic_includes)
     test.add_referenced_grammars();
 
   test.build_parser();
+  test.set_limits(limits);
+  test.set_target_symbol(target);
 
   int errcount = 0;
 
@@ -204,70 +527,168 @@ int main(int argc, char  *argv[])
    * [test number] passed
    * [test number] failed at position [position]
    */
-  for(int caseno=1; !feof(stdin) && !ferror(stdin); caseno++)
+  if(search)
   {
-    std::string word;
-    // read new word
-    // note: words are separated by \0, program is terminated by EOF
-    int ch;
-    while((ch = fgetc(stdin)) != EOF && ch != delimiter)
-      word += ch;
+    std::vector<BnfParser2::Match> matches;
 
+    for(int caseno=1; next_word(input, delimiter, begin, word, length); caseno++)
+    {
+      if(!test.search(word, length, matches))
+      {
+        errcount++;
+        std::cout << "[" << caseno << "] limit exceeded at position " << test.get_error_position() + 1 << std::endl;
+      }
+      for(unsigned k = 0; k < matches.size(); k++)
+      {
+        std::cerr.write(word + matches[k].begin, matches[k].end - matches[k].begin);
+        std::cerr << std::endl;
+        std::cout << "[" << caseno << "] found at position " << matches[k].begin + 1
+          << ", " << matches[k].end - matches[k].begin << " bytes" << std::endl;
+      }
+    }
+    write_reports(test, profile, events);
+    return errcount;
+  }
+
+  if(batch > 0)
+  {
+    std::vector<std::string> words;
+    std::vector<BnfParser2::WordResult> results;
+    int caseno = 1;
+
+    while(begin <= input.size())
+    {
+      words.clear();
+      while(words.size() < batch && next_word(input, delimiter, begin, word, length))
+        words.push_back(std::string(word, length));
+
+      test.parse_words(words, results);
+      for(unsigned k = 0; k < results.size(); k++, caseno++)
+      {
+        if(results[k].code == BnfParser2::Result_Accepted)
+          std::cout << "[" << caseno << "] passed" << std::endl;
+        else
+        {
+          errcount++;
+          std::cout << "[" << caseno << "] "
+            << (results[k].code == BnfParser2::Result_Rejected ? "failed" : "limit exceeded")
+            << " at position " << results[k].error_position + 1 << std::endl;
+        }
+      }
+    }
+    write_reports(test, profile, events);
+    return errcount;
+  }
+
+  std::vector<BnfField> found_fields;
+  std::vector<BnfParser2::ErrorSpan> errors;
+  BnfParseStats parse_stats;
+  for(int caseno=1; next_word(input, delimiter, begin, word, length); caseno++)
+  {
     std::cerr << "---------------RESULT---------------" << std::endl;
-    if(test.parse_word(word))
+    if(test.parse(word, length))
     {
       // print accepted word
       std::cerr << test.get_semantic_string() << std::endl;
-      std::cout << "[" << caseno << "] passed" << std::endl;
+      std::cout << "[" << caseno << "] passed";
+      if(test.get_match_length() != length)
+        std::cout << " prefix of " << test.get_match_length() << " bytes";
+      if(symbols.size() > 1)
+      {
+        std::vector<std::string> matched = test.get_matched_symbols();
+        for(unsigned k = 0; k < matched.size(); k++)
+          std::cout << (k == 0 ? " as " : ", ") << matched[k];
+      }
+      std::cout << std::endl;
+      if(fields)
+      {
+        test.get_fields(found_fields);
+        for(unsigned k = 0; k < found_fields.size(); k++)
+          std::cout << "[" << caseno << "] field " << test.get_field_name(found_fields[k].field)
+            << " at position " << found_fields[k].begin + 1
+            << ", " << found_fields[k].end - found_fields[k].begin << " bytes" << std::endl;
+      }
+    }
+    else if(test.get_result_code() != BnfParser2::Result_Rejected)
+    {
+      errcount++;
+      std::cerr << "Parsing stopped at position " << test.get_error_position() + 1
+        << ", " << limit_name(test.get_result_code()) << " limit exceeded" << std::endl;
+      std::cout << "[" << caseno << "] limit exceeded at position " << test.get_error_position() + 1 << std::endl;
     }
     else
     {
       errcount++;
       // print the word
-      unsigned j = word.size(), line_chars=0;
-      if(test.get_error_position() >= word.size())
-        std::cerr << word << " <-- Unexpected end of input" << std::endl;
+      unsigned j = length, line_chars=0;
+      if(test.get_error_position() >= length)
+      {
+        std::cerr.write(word, length);
+        std::cerr << " <-- Unexpected end of input" << std::endl;
+      }
       else
       {
         for(j = 0; j <= test.get_error_position(); j++)
         {
-          if(word.at(j) == '\n')
+          if(word[j] == '\n')
             line_chars = 0;
           else
             line_chars++;
-          if(word.at(j) == '\r')
+          if(word[j] == '\r')
           {
             std::cerr << "<CR>";
             line_chars += 3;
           }
-          else if(word.at(j) == '\n')
+          else if(word[j] == '\n')
           {
             std::cerr << "<LF>";
             if(j != test.get_error_position())
               std::cerr << std::endl;
           }
           else
-            std::cerr << word.at(j);
+            std::cerr << word[j];
         }
         std::cerr  << "<-- Erroneous character" << std::endl;
         for(unsigned k = 0; k < line_chars; k++)
           std::cerr << ' ';
-        for(/**/;j < word.size(); j++)
+        for(/**/;j < length; j++)
         {
-          if(word.at(j) == '\r')
+          if(word[j] == '\r')
             std::cerr << "<CR>";
-          else if(word.at(j) == '\n')
+          else if(word[j] == '\n')
             std::cerr << "<LF>" << std::endl;
           else
-           std::cerr << word.at(j);
+           std::cerr << word[j];
         }
         std::cerr << std::endl;
       // locate the error
       }
       std::cout << "[" << caseno << "] failed at position " << test.get_error_position() + 1 << std::endl;
+      if(recovery)
+      {
+        test.get_errors(errors);
+        for(unsigned k = 0; k < errors.size(); k++)
+          std::cout << "[" << caseno << "] error at position " << errors[k].position + 1
+            << ", skipped " << errors[k].end - errors[k].begin << " bytes from position "
+            << errors[k].begin + 1 << std::endl;
+      }
+    }
+
+    if(stats)
+    {
+      test.get_parse_stats(parse_stats);
+      std::cout << "[" << caseno << "] stats: " << parse_stats.state_nodes << " states, "
+        << parse_stats.symbol_nodes << " symbols, " << parse_stats.edges << " edges, "
+        << parse_stats.shifts << " shifts, " << parse_stats.reductions << " reductions (";
+      for(unsigned k = 0; k < parse_stats.reductions_by_length.size(); k++)
+        std::cout << (k == 0 ? "" : " ") << k << ":" << parse_stats.reductions_by_length[k];
+      std::cout << "), " << parse_stats.path_steps << " path steps, width "
+        << parse_stats.max_level_width << ", " << parse_stats.ambiguous_symbols << " ambiguous, "
+        << parse_stats.semantic_bytes << " semantic bytes" << std::endl;
     }
   }
 
+  write_reports(test, profile, events);
   return errcount;
 }
 
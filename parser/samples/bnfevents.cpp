@@ -0,0 +1,215 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+
+#include <SimpleOpt.h>
+
+#include "BnfParser2.h"
+#include "config.h"
+
+//! Returns the name of the event type
+static const char *type_name(unsigned type)
+{
+  switch(type)
+  {
+    case BnfEvent::Event_Begin:
+      return "begin";
+    case BnfEvent::Event_Shift:
+      return "shift";
+    case BnfEvent::Event_Reduce:
+      return "reduce";
+    case BnfEvent::Event_StateNode:
+      return "state-node";
+    case BnfEvent::Event_SymbolNode:
+      return "symbol-node";
+    case BnfEvent::Event_Error:
+      return "error";
+    case BnfEvent::Event_End:
+      return "end";
+    default:
+      return "unknown";
+  }
+}
+
+//! Writes the fields of the event the type uses, as "name value" or "\"name\":value"
+static void write_fields(const BnfEvent& event, bool json)
+{
+  std::vector<std::pair<const char *, long> > fields;
+
+  switch(event.type)
+  {
+    case BnfEvent::Event_Begin:
+      fields.push_back(std::make_pair("length", (long)event.value));
+      break;
+    case BnfEvent::Event_Shift:
+      fields.push_back(std::make_pair("state", (long)event.state));
+      fields.push_back(std::make_pair("from-node", (long)event.node));
+      fields.push_back(std::make_pair("from-level", (long)event.node_level));
+      fields.push_back(std::make_pair("column", (long)event.value));
+      break;
+    case BnfEvent::Event_Reduce:
+      fields.push_back(std::make_pair("rule", (long)event.rule));
+      fields.push_back(std::make_pair("length", (long)event.value));
+      fields.push_back(std::make_pair("state", (long)event.state));
+      fields.push_back(std::make_pair("node", (long)event.node));
+      fields.push_back(std::make_pair("node-level", (long)event.node_level));
+      break;
+    case BnfEvent::Event_StateNode:
+      fields.push_back(std::make_pair("state", (long)event.state));
+      fields.push_back(std::make_pair("node", (long)event.node));
+      fields.push_back(std::make_pair("node-level", (long)event.node_level));
+      break;
+    case BnfEvent::Event_SymbolNode:
+      fields.push_back(std::make_pair("symbol", (long)event.value));
+      fields.push_back(std::make_pair("rule", (long)event.rule));
+      fields.push_back(std::make_pair("node", (long)event.node));
+      break;
+    case BnfEvent::Event_Error:
+      fields.push_back(std::make_pair("resume", (long)event.value));
+      break;
+    case BnfEvent::Event_End:
+      fields.push_back(std::make_pair("result", (long)event.value));
+      break;
+  }
+
+  for(unsigned k = 0; k < fields.size(); k++)
+  {
+    if(json)
+      std::cout << (k == 0 ? "" : ",") << "\"" << fields[k].first << "\":" << fields[k].second;
+    else
+      std::cout << " " << fields[k].first << " " << fields[k].second;
+  }
+}
+
+//! Prints one event per line: the time, the level and the fields of the type
+static void print_text(const std::vector<BnfEvent>& events)
+{
+  for(unsigned k = 0; k < events.size(); k++)
+  {
+    const BnfEvent& event = events[k];
+    printf("%6u.%06u s  level %-6u %-11s", event.seconds, event.microseconds, event.level,
+      type_name(event.type));
+    write_fields(event, false);
+    std::cout << std::endl;
+  }
+}
+
+//! Prints the events in the Chrome trace format, see chrome://tracing
+/** A parsing is a slice from its begin to its end event, the other events
+ *  are instant events inside it.
+ */
+static void print_chrome(const std::vector<BnfEvent>& events)
+{
+  std::cout << "{\"traceEvents\":[" << std::endl;
+  for(unsigned k = 0; k < events.size(); k++)
+  {
+    const BnfEvent& event = events[k];
+    const char *phase = (event.type == BnfEvent::Event_Begin) ? "B"
+      : (event.type == BnfEvent::Event_End) ? "E" : "i";
+
+    std::cout << "{\"name\":\"" << (phase[0] == 'i' ? type_name(event.type) : "parse")
+      << "\",\"ph\":\"" << phase << "\",";
+    if(phase[0] == 'i')
+      std::cout << "\"s\":\"t\",";
+    // in microseconds, a double holds them exactly for centuries
+    std::cout << "\"ts\":" << std::fixed << std::setprecision(0)
+      << event.seconds * 1000000.0 + event.microseconds << ",\"pid\":1,\"tid\":1,\"args\":{\"level\":" << event.level << ",";
+    write_fields(event, true);
+    std::cout << "}}" << (k + 1 < events.size() ? "," : "") << std::endl;
+  }
+  std::cout << "]}" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  bool chrome = false;
+
+  enum
+  {
+    OPT_CHROME,
+    OPT_HELP
+  };
+
+  static CSimpleOpt::SOption const long_options[] =
+  {
+    { OPT_CHROME, "-c", SO_NONE },
+    { OPT_CHROME, "--chrome", SO_NONE },
+    { OPT_HELP, "--help", SO_NONE },
+    SO_END_OF_OPTIONS
+  };
+
+  CSimpleOpt args(argc, argv, long_options);
+
+  while(args.Next())
+  {
+    if(args.LastError() != SO_SUCCESS)
+    {
+      printf( "Usage: %s [OPTION]... FILE\n", argv[0] );
+      fprintf( stderr, "Try '%s --help' for more information.\n", argv[0] );
+      exit(1);
+    }
+
+    switch(args.OptionId())
+    {
+      case OPT_CHROME:
+        chrome = true;
+        break;
+
+      case OPT_HELP:
+        printf(
+"Usage: %s [OPTION]... FILE\n"
+"Print the parsing events written by bnfcheck --events.\n"
+"\n"
+"  -c, --chrome              print the Chrome trace format (chrome://tracing)\n"
+"  --help                    display this help and exit\n"
+"\n"
+"Report bugs to <"PACKAGE_BUGREPORT">.\n",
+          argv[0]
+        );
+        exit(0);
+    }
+  }
+
+  if(args.FileCount() != 1)
+  {
+    std::cerr << argv[0] << ": expecting one file" << std::endl;
+    std::cerr << "Try `" << argv[0] << " --help' for more information." << std::endl;
+    return 1;
+  }
+
+  std::vector<BnfEvent> events;
+  if(!BnfParser2::read_events(args.File(0), events))
+  {
+    std::cerr << argv[0] << ": cannot read the events from " << args.File(0) << std::endl;
+    return 1;
+  }
+
+  if(chrome)
+    print_chrome(events);
+  else
+    print_text(events);
+  return 0;
+}
+
+// end of file
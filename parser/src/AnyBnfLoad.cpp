@@ -19,6 +19,7 @@
  */
 
 #include <iostream>
+#include <algorithm>
 #include <limits.h>
 #include <sys/stat.h>
 
@@ -702,6 +703,7 @@ void AnyBnfLoad::transform_names(void)
 
         m_names[m_nonterm_count].m_name = found_word;
         m_names[m_nonterm_count].m_grammar = m_current_grammar;
+        m_names[m_nonterm_count].m_grammar_name = m_current_grammar->first;
 
         logTrace(LOG_DEBUG, found_word << " => " << m_nonterm_count);
         m_nonterm_count++;
@@ -1166,7 +1168,7 @@ std::queue<int> AnyBnfLoad::get_nonterm (int nonterminal)
 
   //for all rules that have the sought nonterminal on the left side
   //take all nonterminals on the right side and put them into a queue.
-  range_iter=m_global_table.equal_range(nonterminal);
+  range_iter=m_parser_table.equal_range(nonterminal);
   for (CIT i=range_iter.first; i!=range_iter.second; ++i)
   {
     for (unsigned vect=0; vect!=i->second.size(); vect++)
@@ -1182,7 +1184,7 @@ std::queue<int> AnyBnfLoad::get_nonterm (int nonterminal)
     }
   }
 
-  range_iter=m_global_table.equal_range(INT_MAX - nonterminal);
+  range_iter=m_parser_table.equal_range(INT_MAX - nonterminal);
   for (CIT i=range_iter.first; i!=range_iter.second; ++i)
   {
     for (unsigned vect=0; vect!=i->second.size(); vect++)
@@ -1235,57 +1237,86 @@ std::set<int> AnyBnfLoad::process_nonterm
   return(next);
 }
 
-void AnyBnfLoad::remove_unreachable (void)
+int AnyBnfLoad::find_start_symbol(const std::string& symbol, const std::string& grammar)
 {
-  //Before removing the unusable nonterminals, connections among
-  //the grammars are made
-  std::vector<int> right_side;
+  int start_symbol_number = -1;
 
-  if(!m_start_set)
-    throw std::runtime_error("Start symbol not set");
-
-  if(!m_start_grammar.empty())
+  if(!grammar.empty())
   {
-    logTrace(LOG_INFO, "  using start symbol " << m_start_symbol << " from " << m_start_grammar);
+    logTrace(LOG_INFO, "  using start symbol " << symbol << " from " << grammar);
     // find start symbol in given start grammar
-    m_start_symbol_number = get_nonterm_id(m_start_grammar, m_start_symbol);
+    start_symbol_number = get_nonterm_id(grammar, symbol);
 
-    if(m_start_symbol_number == -1)
+    if(start_symbol_number == -1)
     {
-      throw std::runtime_error("Symbol \"" + m_start_symbol
-        + "\" not found in \"" + m_start_grammar + "\" specification");
+      throw std::runtime_error("Symbol \"" + symbol
+        + "\" not found in \"" + grammar + "\" specification");
     }
   }
   else
   {
-    m_start_symbol_number = -1;
     // search start symbol in grammar files
     for(std::map<std::string, GrammarInfo>::iterator pos = m_grammars.begin();
       pos != m_grammars.end(); pos++)
     {
-      logTrace(LOG_INFO, "  looking for symbol " << m_start_symbol << " in " << pos->first);
+      logTrace(LOG_INFO, "  looking for symbol " << symbol << " in " << pos->first);
       int idpos;
-      if((idpos = pos->second.m_nonterm_names[m_start_symbol]) != -1)
+      if((idpos = pos->second.m_nonterm_names[symbol]) != -1)
       {
-        logTrace(LOG_INFO, "  symbol " << m_start_symbol << " found in " << pos->first);
-        if(m_start_symbol_number != -1)
-          logTrace(LOG_ERR, "  duplicate start symbol " << m_start_symbol << " in " << pos->first);
+        logTrace(LOG_INFO, "  symbol " << symbol << " found in " << pos->first);
+        if(start_symbol_number != -1)
+          logTrace(LOG_ERR, "  duplicate start symbol " << symbol << " in " << pos->first);
         else
-          m_start_symbol_number = idpos;
+          start_symbol_number = idpos;
       }
     }
 
-    if(m_start_symbol_number == -1)
+    if(start_symbol_number == -1)
     {
-      throw std::runtime_error("Symbol \"" + m_start_symbol
+      throw std::runtime_error("Symbol \"" + symbol
         + "\" not found in any specification");
     }
   }
 
+  return start_symbol_number;
+}
+
+void AnyBnfLoad::remove_unreachable (void)
+{
+  //Before removing the unusable nonterminals, connections among
+  //the grammars are made
+  std::vector<int> right_side;
+
+  if(!m_start_set)
+    throw std::runtime_error("Start symbol not set");
+
+  // the loaded grammars are kept intact, so that more grammars may be added
+  // and the parser built again
+  m_parser_table = m_global_table;
+
   //inserting starting nonterminal
-  right_side.push_back(m_start_symbol_number);
-  m_global_table.insert(std::make_pair(1, right_side));
-  right_side.clear();
+  if(m_start_symbols.size() == 1)
+  {
+    right_side.push_back(find_start_symbol(m_start_symbols[0].first, m_start_symbols[0].second));
+    m_parser_table.insert(std::make_pair(1, right_side));
+    right_side.clear();
+  }
+  else
+  {
+    // the marked alternatives keep the choice out of the tokens
+    if(m_start_choice == -1)
+      m_start_choice = m_nonterm_count++;
+    right_side.push_back(m_start_choice);
+    m_parser_table.insert(std::make_pair(1, right_side));
+    right_side.clear();
+
+    for(unsigned k = 0; k < m_start_symbols.size(); k++)
+    {
+      right_side.push_back(INT_MAX - find_start_symbol(m_start_symbols[k].first, m_start_symbols[k].second));
+      m_parser_table.insert(std::make_pair(m_start_choice, right_side));
+      right_side.clear();
+    }
+  }
   
   for(std::list<dependency>::iterator pos = m_dependencies.begin();
     pos != m_dependencies.end(); pos++)
@@ -1310,7 +1341,7 @@ void AnyBnfLoad::remove_unreachable (void)
         if(sonid != -1)
         {
           right_side.push_back((int)denpos->second);
-          m_global_table.insert(std::make_pair(sonid, right_side));
+          m_parser_table.insert(std::make_pair(sonid, right_side));
           right_side.clear();
         }
       }
@@ -1337,7 +1368,7 @@ void AnyBnfLoad::remove_unreachable (void)
       else
       {
         right_side.push_back(pos->dest_num);
-        m_global_table.insert(std::make_pair(pos->source_num, right_side));
+        m_parser_table.insert(std::make_pair(pos->source_num, right_side));
         right_side.clear();
       }
     }
@@ -1350,7 +1381,7 @@ void AnyBnfLoad::remove_unreachable (void)
     if(pos->source_num != -1 && pos->dest_num != -1)
     {
       right_side.push_back(pos->dest_num);
-      m_global_table.insert(std::make_pair(pos->source_num, right_side));
+      m_parser_table.insert(std::make_pair(pos->source_num, right_side));
       right_side.clear();
     }
   }
@@ -1395,7 +1426,7 @@ void AnyBnfLoad::remove_unreachable (void)
     if (processed_nonterm.find(i) != processed_nonterm.end())
     {
       nonterm_present = true;
-      range_iter=m_global_table.equal_range(i);
+      range_iter=m_parser_table.equal_range(i);
       if(range_iter.first == range_iter.second)
         nonterm_present = false;
         
@@ -1408,7 +1439,7 @@ void AnyBnfLoad::remove_unreachable (void)
           std::cerr << std::endl;
         }
       
-      range_iter=m_global_table.equal_range(INT_MAX - i);
+      range_iter=m_parser_table.equal_range(INT_MAX - i);
       if(range_iter.first == range_iter.second && !nonterm_present)
       {
         BnfReport report(m_interface->get_reporter(), BnfReporter::ErrorType_Warning);
@@ -1429,8 +1460,8 @@ void AnyBnfLoad::remove_unreachable (void)
     //erased
     else
     {
-      m_global_table.erase(i);
-      m_global_table.erase(INT_MAX - i);
+      m_parser_table.erase(i);
+      m_parser_table.erase(INT_MAX - i);
     }
   }
 }
@@ -1450,12 +1481,8 @@ void AnyBnfLoad::add_referenced_grammars()
   }
 }
 
-void AnyBnfLoad::add_grammar(const char *grammar_name, const char *syntax_name)
+std::string AnyBnfLoad::find_grammar_file(const char *grammar_name) const
 {
-  std::string line_test;
-
-  logTrace(LOG_INFO, "## File processing start ##");
-
   std::string grammar_filename = grammar_name;
   // search for grammar file
   std::vector<std::string>::const_iterator gpos = m_search_paths.begin();
@@ -1466,16 +1493,26 @@ void AnyBnfLoad::add_grammar(const char *grammar_name, const char *syntax_name)
     // search for the given file
     struct stat fileinfo;
     if(stat(grammar_filename.c_str(), &fileinfo) == 0)
-      break;
+      return grammar_filename;
     if(gpos == m_search_paths.end())
       throw std::runtime_error("Grammar file not found");
 
     grammar_filename = *(gpos++) + "/" + grammar_name;
   }
+}
+
+void AnyBnfLoad::add_grammar(const char *grammar_name, const char *syntax_name)
+{
+  std::string line_test;
+
+  logTrace(LOG_INFO, "## File processing start ##");
+
+  std::string grammar_filename = find_grammar_file(grammar_name);
 
   // load grammar file
   logTrace(LOG_INFO, "  loading grammar: " << grammar_filename);
   m_grammar.load_file(grammar_filename);
+  m_loaded_files.push_back(grammar_filename);
 
   std::string syntax_name_s;
   if(syntax_name != NULL )
@@ -1513,6 +1550,8 @@ void AnyBnfLoad::add_grammar(const char *grammar_name, const char *syntax_name)
   // load grammar syntax confinguration
   logTrace(LOG_INFO, "  loading configuration: " << syntax_filename);
   m_config.parse_conf(syntax_filename);
+  if(std::find(m_loaded_files.begin(), m_loaded_files.end(), syntax_filename) == m_loaded_files.end())
+    m_loaded_files.push_back(syntax_filename);
 //  m_config.check_conf(std::cout); // debugging output
 
   // insert new grammar to the list, get iterator to the entry
@@ -1554,11 +1593,51 @@ void AnyBnfLoad::add_grammar(const char *grammar_name, const char *syntax_name)
   logTrace(LOG_INFO, "## File processing end ##");
 }
 
+void AnyBnfLoad::write_names(std::ostream& out) const
+{
+  out << m_names.size() << '\n';
+  for(std::map<int, NonterminalInfo>::const_iterator pos = m_names.begin();
+    pos != m_names.end(); pos++)
+  {
+    out << pos->first << ' ' << pos->second.m_name << '\n'
+      << pos->second.m_grammar_name << '\n';
+  }
+}
+
+bool AnyBnfLoad::read_names(std::istream& in)
+{
+  size_t count;
+  int number;
+  std::string name, grammar_name;
+
+  if(!(in >> count))
+    return false;
+  for(size_t i = 0; i < count; i++)
+  {
+    // the grammar name is on a line of its own, it may contain spaces
+    if(!(in >> number >> name) || !in.ignore(INT_MAX, '\n') || !std::getline(in, grammar_name))
+      return false;
+    // the grammar is not loaded, so there is no entry to point to
+    m_names[number].m_name = name;
+    m_names[number].m_grammar = m_grammars.end();
+    m_names[number].m_grammar_name = grammar_name;
+  }
+  return true;
+}
+
 void AnyBnfLoad::set_start_symbol(const char *symbol_name, const char *start_grammar_name)
 {
   m_start_set = true;
-  m_start_symbol = symbol_name;
-  m_start_grammar = start_grammar_name ? start_grammar_name : "";
+  m_start_symbols.clear();
+  m_start_symbols.push_back(std::make_pair(std::string(symbol_name),
+    std::string(start_grammar_name ? start_grammar_name : "")));
+}
+
+void AnyBnfLoad::add_start_symbol(const char *symbol_name, const char *start_grammar_name)
+{
+  m_start_set = true;
+  m_start_symbols.push_back(std::make_pair(std::string(symbol_name),
+    std::string(start_grammar_name ? start_grammar_name : "")));
 }
 
 #ifdef _ANYBNFLOAD_TEST_
@@ -53,18 +53,17 @@ private:
   AnyBnfFile m_grammar;             //!<for manipulation with input file
   AnyBnfConf m_config;              //!<for manipulation with configuration file
 
-  //!Contains the name of the starting nonterminal.
-  std::string m_start_symbol;
-  
-  //!Contains the name of the grammar containing the starting nonterminal.  
-  std::string m_start_grammar;
-  
-  //!Contains the global number of the starting nonterminal.
-  int m_start_symbol_number;
+  //!Contains the names of the starting nonterminals and of the grammars containing them.
+  /** The grammar name is empty when the nonterminal is searched in all grammars.
+   */
+  std::vector<std::pair<std::string, std::string> > m_start_symbols;
   
   //! Is set to true when the starting nonterminal is set
   bool m_start_set;
 
+  //! The nonterminal deriving each of several starting nonterminals, -1 if not allocated
+  int m_start_choice;
+
   //!Encapsulation of int, default value is -1 instead of 0.
   class count 
   {
@@ -163,6 +162,7 @@ private:
   public:
     std::string m_name;
     GrammarMap::const_iterator m_grammar; //!< iterator to m_grammars
+    std::string m_grammar_name;           //!< kept when m_grammar is not loaded
     // Note: iterators to map are not invalidated by insertion/removal of other entries.
   };
   //!Maps all the nonterminal numbers back to its original names.
@@ -183,9 +183,15 @@ private:
    */
   std::multimap<int, std::vector<int> > m_global_table;
 
+  //!Rules passed to the parser, made by remove_unreachable() from #m_global_table.
+  std::multimap<int, std::vector<int> > m_parser_table;
+
   //! A list of paths where grammar and syntax specifications are located.
   std::vector<std::string> m_search_paths;
 
+  //! Paths of all the grammar and syntax specification files loaded.
+  std::vector<std::string> m_loaded_files;
+
   //!Gives a value of the first !syntax() parameter.
   std::string get_syntax(void);
     
@@ -249,10 +255,15 @@ private:
   //!Internal function used by remove_unreachable()
   std::queue<int> get_nonterm (int nonterminal);
 
+  //!Internal function used by remove_unreachable(), returns the number of a starting nonterminal
+  int find_start_symbol(const std::string& symbol, const std::string& grammar);
+
 public:
   //!Removes non-terminals and rules that cannot be reached from the starting rule.
   /** Before doing that, new rules (defined in the #m_dependencies strucure and
    *  the rule for the starting nonterminal) are added to the table.
+   *  The result is stored separately, so the function may be called again
+   *  when more grammars were added.
    */ 
   void remove_unreachable (void);
 
@@ -262,6 +273,15 @@ public:
     m_search_paths.push_back(path);
   }
 
+  //! Returns the list of paths where grammar and syntax specifications are located
+  const std::vector<std::string>& get_search_paths(void) const
+  {
+    return m_search_paths;
+  }
+
+  //! Searches the search paths for the given grammar file, returns its path
+  std::string find_grammar_file(const char *grammar_name) const;
+
   //! Calls add_grammar() for unresolved references
   void add_referenced_grammars();
 
@@ -277,17 +297,66 @@ public:
   //!  Sets the name of the starting nonterminal and the name of the file containing it.
   void set_start_symbol(const char *symbol_name, const char *start_grammar_name = NULL);
 
-  //! Returns entire grammar structure
+  //! Adds another starting nonterminal, see set_start_symbol()
+  /** With several starting nonterminals the rule 1 -> X is inserted, where X
+   *  is a new nonterminal with a marked alternative for each of them.
+   */
+  void add_start_symbol(const char *symbol_name, const char *start_grammar_name = NULL);
+
+  //! Returns the names of the starting nonterminals and of the grammars containing them
+  const std::vector<std::pair<std::string, std::string> >& get_start_symbols(void) const
+  {
+    return m_start_symbols;
+  }
+
+  //! Returns paths of all grammar and syntax specification files loaded so far
+  const std::vector<std::string>& get_loaded_files(void) const
+  {
+    return m_loaded_files;
+  }
+
+  //! Writes the nonterminal names to a stream (used by the grammar cache)
+  void write_names(std::ostream& out) const;
+
+  //! Reads the nonterminal names written by write_names()
+  /** Used when the grammar was not loaded, but taken from the cache.
+   */
+  bool read_names(std::istream& in);
+
+  //! Returns the grammar structure made by remove_unreachable()
   const std::multimap<int, std::vector<int> >& get_grammar(void) const
   {
-    return m_global_table;
+    return m_parser_table;
+  }
+
+  //! Returns the numbers of the nonterminals with the given name, in any grammar
+  std::vector<int> find_nonterminals(const std::string& name) const
+  {
+    std::vector<int> result;
+    for(std::map<int, NonterminalInfo>::const_iterator pos = m_names.begin(); pos != m_names.end(); pos++)
+      if(pos->second.m_name == name)
+        result.push_back(pos->first);
+    return result;
   }
 
   //! Returns the name of the specified nonterminal (if it is marked)
-  std::string get_marked_name(int nonterm_number)
+  std::string get_marked_name(int nonterm_number) const
+  {
+    std::map<int, NonterminalInfo>::const_iterator pos = m_names.find(nonterm_number);
+    if(pos != m_names.end())
+      return pos->second.m_name;
+    else
+      return "";
+  }
+
+  //! Returns the name of the grammar defining the nonterminal, empty if not known
+  /** The grammars are not known when the names were read from the cache.
+   */
+  std::string get_grammar_name(int nonterm_number) const
   {
-    if(m_names.count(nonterm_number) > 0)
-      return m_names[nonterm_number].m_name;
+    std::map<int, NonterminalInfo>::const_iterator pos = m_names.find(nonterm_number);
+    if(pos != m_names.end())
+      return pos->second.m_grammar_name;
     else
       return "";
   }
@@ -300,7 +369,8 @@ public:
 
   //!Constructor takes the verbose level.
   AnyBnfLoad(BnfParser2 *interface)
-  : m_interface(interface), m_grammar(interface), m_start_set(false), m_nonterm_count(2)
+  : m_interface(interface), m_grammar(interface), m_start_set(false), m_start_choice(-1),
+    m_nonterm_count(2)
   {}
 
 };
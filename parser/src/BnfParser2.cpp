@@ -34,18 +34,41 @@ BnfParser2::BnfParser2(void)
 {
   m_core_parser = new Parser(this);
   m_reporter = NULL;
+  m_registry = NULL;
+  m_snapshot = NULL;
 }
 
 BnfParser2::~BnfParser2(void)
 {
+  attach(NULL);
   delete m_core_parser;
 }
 
+void BnfParser2::attach(BnfRegistry *registry)
+{
+  if(m_registry != NULL)
+    m_registry->release(m_snapshot);
+
+  m_registry = registry;
+  m_snapshot = NULL;
+  m_core_parser->use_grammar_of(NULL);
+}
+
 void BnfParser2::add_search_path(const char *path)
 {
   m_core_parser->add_search_path(path);
 }
 
+void BnfParser2::set_cache_directory(const char *path)
+{
+  m_core_parser->set_cache_directory(path);
+}
+
+void BnfParser2::set_token_extraction(bool enabled)
+{
+  m_core_parser->set_token_extraction(enabled);
+}
+
 void BnfParser2::add_grammar(const char *syntax_name, const char *variant_name)
 {
   m_core_parser->add_grammar(syntax_name, variant_name);
@@ -61,6 +84,21 @@ void BnfParser2::set_start_symbol(const char *symbol_name, const char *start_gra
   m_core_parser->set_start_symbol(symbol_name, start_grammar_name);
 }
 
+void BnfParser2::add_start_symbol(const char *symbol_name, const char *start_grammar_name)
+{
+  m_core_parser->add_start_symbol(symbol_name, start_grammar_name);
+}
+
+void BnfParser2::set_target_symbol(const char *symbol_name)
+{
+  m_core_parser->set_target_symbol(symbol_name ? symbol_name : "");
+}
+
+void BnfParser2::add_recovery_symbol(const char *symbol_name, const char *terminator)
+{
+  m_core_parser->add_recovery_symbol(symbol_name, terminator);
+}
+
 void BnfParser2::build_parser(void)
 {
   m_core_parser->build_parser();
@@ -78,14 +116,143 @@ void BnfParser2::set_verbose_level(unsigned level)
 
 bool BnfParser2::parse_word(const std::string& word)
 {
+  // the grammar may be replaced between two words, never during the parsing
+  if(m_registry != NULL)
+    m_core_parser->use_grammar_of(m_registry->acquire(m_snapshot));
+
   return m_core_parser->parse_word(word);
 }
 
+bool BnfParser2::parse(const char *data, size_t length)
+{
+  if(m_registry != NULL)
+    m_core_parser->use_grammar_of(m_registry->acquire(m_snapshot));
+
+  return m_core_parser->parse(data, length);
+}
+
+bool BnfParser2::parse_document(const std::string& document)
+{
+  if(m_registry != NULL)
+    m_core_parser->use_grammar_of(m_registry->acquire(m_snapshot));
+
+  return m_core_parser->parse_document(document);
+}
+
+bool BnfParser2::reparse(size_t offset, size_t removed_length, const std::string& inserted)
+{
+  if(m_registry != NULL)
+    m_core_parser->use_grammar_of(m_registry->acquire(m_snapshot));
+
+  return m_core_parser->reparse(offset, removed_length, inserted.data(), inserted.size());
+}
+
+const std::string& BnfParser2::get_document(void)
+{
+  return m_core_parser->get_document();
+}
+
+void BnfParser2::parse_words(const std::vector<std::string>& words, std::vector<WordResult>& results)
+{
+  if(m_registry != NULL)
+    m_core_parser->use_grammar_of(m_registry->acquire(m_snapshot));
+
+  m_core_parser->parse_words(words, results);
+}
+
+bool BnfParser2::search(const std::string& buffer, std::vector<Match>& matches)
+{
+  return search(buffer.data(), buffer.size(), matches);
+}
+
+bool BnfParser2::search(const char *buffer, size_t length, std::vector<Match>& matches)
+{
+  if(m_registry != NULL)
+    m_core_parser->use_grammar_of(m_registry->acquire(m_snapshot));
+
+  return m_core_parser->search(buffer, length, matches);
+}
+
 bool BnfParser2::get_parsing_result(void)
 {
   return m_core_parser->get_parsing_result();
 }
 
+void BnfParser2::set_limits(const BnfLimits& limits)
+{
+  m_core_parser->set_limits(limits);
+}
+
+void BnfParser2::set_prefilter(bool enabled)
+{
+  m_core_parser->set_prefilter(enabled);
+}
+
+void BnfParser2::set_match_mode(MatchMode mode)
+{
+  m_core_parser->set_match_mode(mode);
+}
+
+unsigned BnfParser2::get_match_length(void)
+{
+  return m_core_parser->get_match_length();
+}
+
+std::vector<std::string> BnfParser2::get_matched_symbols(void)
+{
+  return m_core_parser->get_matched_symbols();
+}
+
+void BnfParser2::set_ambiguity_policy(AmbiguityPolicy policy, unsigned max_ways)
+{
+  m_core_parser->set_ambiguity_policy(policy, max_ways);
+}
+
+void BnfParser2::get_parse_stats(BnfParseStats& stats)
+{
+  m_core_parser->get_parse_stats(stats);
+}
+
+void BnfParser2::set_profiling(bool enabled)
+{
+  m_core_parser->set_profiling(enabled);
+}
+
+void BnfParser2::get_profile(BnfProfile& profile)
+{
+  m_core_parser->get_profile(profile);
+}
+
+void BnfParser2::set_event_recording(unsigned capacity)
+{
+  m_core_parser->get_recorder().set_capacity(capacity);
+}
+
+void BnfParser2::get_events(std::vector<BnfEvent>& events)
+{
+  m_core_parser->get_recorder().get_events(events);
+}
+
+bool BnfParser2::write_events(const char *file_name)
+{
+  return m_core_parser->get_recorder().write(file_name);
+}
+
+bool BnfParser2::read_events(const char *file_name, std::vector<BnfEvent>& events)
+{
+  return EventRecorder::read(file_name, events);
+}
+
+BnfParser2::ResultCode BnfParser2::get_result_code(void)
+{
+  return m_core_parser->get_result_code();
+}
+
+void BnfParser2::get_errors(std::vector<ErrorSpan>& errors)
+{
+  errors = m_core_parser->get_errors();
+}
+
 unsigned BnfParser2::get_error_position(void)
 {
   return m_core_parser->get_error_position();
@@ -96,4 +263,24 @@ std::string BnfParser2::get_semantic_string(void)
   return m_core_parser->get_semantic_string();
 }
 
+void BnfParser2::visit_semantics(BnfVisitor& visitor)
+{
+  m_core_parser->visit_semantics(visitor);
+}
+
+unsigned BnfParser2::add_field(const char *mark_name)
+{
+  return m_core_parser->add_field(mark_name);
+}
+
+void BnfParser2::get_fields(std::vector<BnfField>& fields)
+{
+  m_core_parser->get_fields(fields);
+}
+
+std::string BnfParser2::get_field_name(unsigned field)
+{
+  return m_core_parser->get_field_name(field);
+}
+
 // end of file
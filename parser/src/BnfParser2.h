@@ -20,7 +20,12 @@
 #ifndef _BNFPARSER2_
 #define _BNFPARSER2_
 
+#include <cstddef>
 #include <string>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 #ifndef BNFPARSER2_EXP_DEFN
 #ifdef _WIN32
@@ -33,6 +38,175 @@
 #include "BnfReporter.h"
 
 class Parser;
+class BnfRegistry;
+class GrammarSnapshot;
+
+//! Limits of the resources used by one parse_word().
+/**
+ * Ambiguous grammars may cause some inputs to take very long to parse. The
+ * limits bound the effort spent on one word, a zero value means unlimited.
+ * All the limits are unlimited by default.
+ */
+class BNFPARSER2_EXP_DEFN BnfLimits
+{
+public:
+  unsigned long max_reductions;     //!< reductions performed
+  unsigned long max_nodes;          //!< state and symbol nodes of the graph-structured stack
+  unsigned long max_edges;          //!< edges of the graph-structured stack
+  unsigned long max_semantic_bytes; //!< total size of the markup of the semantic values built
+  unsigned long max_time;           //!< wall-clock time in milliseconds
+
+  BnfLimits(void)
+  : max_reductions(0), max_nodes(0), max_edges(0), max_semantic_bytes(0), max_time(0)
+  {}
+};
+
+//! Statistics of the work done by one parse_word(), see BnfParser2::get_parse_stats().
+/**
+ * The counters are collected by every parsing at the cost of an increment
+ * per action. The nodes, the edges and the semantic bytes describe the
+ * graph-structured stack built for the word, the other counters the work of
+ * the last call only, i.e. of the part parsed again by BnfParser2::reparse().
+ * No stack is built for a word of a regular grammar, recognized by a DFA,
+ * all the counters are then zero.
+ */
+class BNFPARSER2_EXP_DEFN BnfParseStats
+{
+public:
+  unsigned long state_nodes;        //!< state nodes of the graph-structured stack
+  unsigned long symbol_nodes;       //!< symbol nodes of the graph-structured stack
+  unsigned long edges;              //!< edges of the graph-structured stack
+  unsigned long shifts;             //!< shifts of a byte or a token performed
+  unsigned long reductions;         //!< reductions performed
+  std::vector<unsigned long> reductions_by_length; //!< reductions performed, indexed by the rule length
+  unsigned long path_steps;         //!< steps of the search for the paths to reduce
+  unsigned long max_level_width;    //!< state nodes at the most crowded position
+  unsigned long ambiguous_symbols;  //!< symbol nodes several derivations were packed into
+  unsigned long semantic_bytes;     //!< total size of the markup of the semantic values built
+
+  BnfParseStats(void)
+  : state_nodes(0), symbol_nodes(0), edges(0), shifts(0), reductions(0), path_steps(0),
+    max_level_width(0), ambiguous_symbols(0), semantic_bytes(0)
+  {}
+};
+
+//! The work done by one rule of the grammar, see BnfProfile.
+class BNFPARSER2_EXP_DEFN BnfRuleProfile
+{
+public:
+  std::string grammar;        //!< the grammar defining the nonterminal, empty if not known
+  std::string nonterminal;    //!< the nonterminal the rule belongs to
+  std::string rule;           //!< the rule, the generated nonterminals written as #number
+  unsigned long reductions;   //!< reductions performed by the rule
+  unsigned long path_steps;   //!< steps of the search for the paths its reductions walked
+
+  BnfRuleProfile(void)
+  : reductions(0), path_steps(0)
+  {}
+};
+
+//! The splits of the stack in one state of the parser table, see BnfProfile.
+class BNFPARSER2_EXP_DEFN BnfStateProfile
+{
+public:
+  unsigned state;                 //!< the number of the state
+  unsigned long splits;           //!< state nodes with several actions on their lookahead
+  std::vector<std::string> rules; //!< the rules the state reduces by on such a lookahead
+
+  BnfStateProfile(void)
+  : state(0), splits(0)
+  {}
+};
+
+//! The work of the parsings per grammar rule and per parser state, see BnfParser2::get_profile().
+/**
+ * Tells which rules make a grammar slow, e.g. to rewrite them. The rules
+ * generated for the repetitions and the groups belong to the nonterminal
+ * they were written in. Only the rules and the states with some work are
+ * listed, in the order of the parser table.
+ */
+class BNFPARSER2_EXP_DEFN BnfProfile
+{
+public:
+  std::vector<BnfRuleProfile> rules;
+  std::vector<BnfStateProfile> states;
+};
+
+//! One event of the parsing, see BnfParser2::set_event_recording().
+/**
+ * The meaning of the node and the value depends on the type, a field not
+ * used by the type is -1 (or UINT_MAX when unsigned).
+ */
+class BNFPARSER2_EXP_DEFN BnfEvent
+{
+public:
+  //! The types of the events
+  enum Type
+  {
+    Event_Begin,       //!< a parsing started, the value is the length of the word
+    Event_Shift,       //!< the state was shifted to at the level, from the node at the node level, the value is the column
+    Event_Reduce,      //!< the rule was reduced from the node in the state, the value is the length
+    Event_StateNode,   //!< the state node was created at the node level
+    Event_SymbolNode,  //!< the symbol node was created, the value is the symbol, the rule is -1 for a terminal
+    Event_Error,       //!< a syntax error at the level, the value is the position the parsing continues at or -1
+    Event_End          //!< the parsing ended, the value is the BnfParser2::ResultCode
+  };
+
+  unsigned seconds;       //!< the seconds since the recording was enabled
+  unsigned microseconds;  //!< the microseconds to add to the seconds
+  unsigned type;          //!< the Type of the event
+  unsigned level;         //!< the level of the graph-structured stack processed, i.e. the position
+  int state;              //!< the state of the parser table
+  int rule;               //!< the rule of the parser table
+  unsigned node;          //!< the number of the node, within its level for a state node
+  unsigned node_level;    //!< the level of the state node
+  int value;              //!< the value given by the type
+
+  BnfEvent(void)
+  : seconds(0), microseconds(0), type(Event_Begin), level(0), state(-1), rule(-1), node(~0U), node_level(~0U), value(-1)
+  {}
+};
+
+//! Receives the markup of the accepted word, see BnfParser2::visit_semantics().
+/**
+ * The offsets are the positions in the word passed to parse_word(). The
+ * text of a marked nonterminal is the part of the word between the offsets
+ * of its enter() and leave().
+ */
+class BNFPARSER2_EXP_DEFN BnfVisitor
+{
+public:
+  //! The events of an ambiguous part of the word
+  enum AmbiguityEvent
+  {
+    Ambiguity_Begin,         //!< the start of the derivations of the part
+    Ambiguity_Alternative,   //!< the start of one derivation
+    Ambiguity_End            //!< the end of the derivations
+  };
+
+  virtual ~BnfVisitor() { }
+
+  //! Callback method invoked at the start of a marked nonterminal
+  virtual void enter(const std::string& name, unsigned begin) = 0;
+
+  //! Callback method invoked at the end of a marked nonterminal
+  virtual void leave(const std::string& name, unsigned end) = 0;
+
+  //! Callback method invoked for the ambiguous parts, ignored by default
+  /** Each derivation of the part starts with Ambiguity_Alternative at the
+   *  start of the part, all of them end at the offset of Ambiguity_End.
+   */
+  virtual void ambiguity(AmbiguityEvent event, unsigned offset) { }
+};
+
+//! A marked nonterminal of the accepted word, see BnfParser2::get_fields().
+class BNFPARSER2_EXP_DEFN BnfField
+{
+public:
+  unsigned field;   //!< The number add_field() returned for the nonterminal
+  unsigned begin;   //!< The position of its first byte in the word
+  unsigned end;     //!< The position after its last byte
+};
 
 //! Generic BNF-adaptable parser.
 /**
@@ -42,11 +216,12 @@ class Parser;
  * To use the parser
  * -# Call add_grammar() to load a syntax specification. May be called
  *    multiple times.
- * -# Call set_start_symbol() to set a start symbol.
+ * -# Call set_start_symbol() to set a start symbol, add_start_symbol() to add more.
  * -# Call build_parser() to process the specifications and build the parser.
  * -# Call parse_word() to parse a word. May be called multiple times.
- * -# Call get_error_position() or get_semantic_string() to obtain results of
- *    the parsing.
+ *    More specifications may be added and build_parser() called again.
+ * -# Call get_error_position(), get_semantic_string(), visit_semantics()
+ *    or get_fields() to obtain results of the parsing.
  */
 class BNFPARSER2_EXP_DEFN BnfParser2
 {
@@ -54,7 +229,68 @@ class BNFPARSER2_EXP_DEFN BnfParser2
   Parser *m_core_parser;
   BnfReporter *m_reporter;
 
+  //! The registry providing the grammar, NULL if not attached
+  BnfRegistry *m_registry;
+  //! The grammar of the registry used by the last parse_word()
+  GrammarSnapshot *m_snapshot;
+
+  friend class BnfRegistry;
+
 public:
+  //! Result of the last parsing, see get_result_code()
+  enum ResultCode
+  {
+    Result_Accepted = 0,     //!< the word was accepted
+    Result_Rejected,         //!< the word is not valid
+    Result_ReductionLimit,   //!< BnfLimits::max_reductions exceeded
+    Result_NodeLimit,        //!< BnfLimits::max_nodes exceeded
+    Result_EdgeLimit,        //!< BnfLimits::max_edges exceeded
+    Result_SemanticLimit,    //!< BnfLimits::max_semantic_bytes exceeded
+    Result_TimeLimit         //!< BnfLimits::max_time exceeded
+  };
+
+  //! Handling of ambiguous derivations, see set_ambiguity_policy()
+  enum AmbiguityPolicy
+  {
+    Ambiguity_KeepAll = 0,   //!< keep all derivations, the default
+    Ambiguity_KeepFirst,     //!< keep the first derivation found
+    Ambiguity_KeepN,         //!< keep at most N derivations
+    Ambiguity_PreferRule     //!< keep the derivation by the alternative given first
+  };
+
+  //! The part of the word accepted by parse_word(), see set_match_mode()
+  enum MatchMode
+  {
+    Match_Whole = 0,         //!< the whole word, the default
+    Match_Longest,           //!< the longest prefix of the word
+    Match_Shortest           //!< the shortest prefix of the word
+  };
+
+  //! A part of the buffer found by search()
+  class Match
+  {
+  public:
+    unsigned begin;           //!< the position of the first byte
+    unsigned end;             //!< the position after the last byte
+  };
+
+  //! A syntax error of the word, see get_errors()
+  class ErrorSpan
+  {
+  public:
+    unsigned position;        //!< the position the error was found at
+    unsigned begin;           //!< the start of the recovery symbol skipped
+    unsigned end;             //!< the position the parsing continued at, the word length if not
+  };
+
+  //! Result of one word parsed by parse_words()
+  class WordResult
+  {
+  public:
+    ResultCode code;          //!< see get_result_code()
+    unsigned error_position;  //!< see get_error_position()
+  };
+
   //! A constructor.
   BnfParser2(void);
 
@@ -70,6 +306,35 @@ public:
    */
   void add_search_path(const char *path);
 
+  //! Set the directory of the compiled grammar cache.
+  /**
+   * Optional. Must be called before add_grammar(). The build_parser() then
+   * looks up a table built previously for the same grammar files, the same
+   * start symbol and the same library version. If the table is found, the
+   * specifications are not processed at all. Otherwise the table is built and
+   * stored in the directory.
+   *
+   * The files are only located by add_grammar() and add_referenced_grammars(),
+   * their processing is postponed to build_parser().
+   *
+   * \param[in] path Absolute or relative path. The directory is created if
+   *   it does not exist.
+   */
+  void set_cache_directory(const char *path);
+
+  //! Enable or disable the lexical analysis of the regular nonterminals.
+  /**
+   * Optional, enabled by default. Must be called before build_parser(). The
+   * nonterminals that generate a regular language and contain no marked
+   * nonterminals are recognized by finite automata, the GLR parser then
+   * processes them as single tokens. If the whole grammar is regular, the
+   * words are recognized by a minimal DFA without the GLR parser. The results
+   * of parse_word() are the same, only faster.
+   *
+   * \param[in] enabled False to parse the whole grammar byte by byte.
+   */
+  void set_token_extraction(bool enabled);
+
   //! Load a syntax specification file.
   /**
    * Mutliple calls possible. The list of directories specified using
@@ -102,7 +367,67 @@ public:
    */
   void set_start_symbol(const char *symbol_name, const char *start_grammar_name = NULL);
 
+  //! Add another start symbol.
+  /**
+   * Optional, called after set_start_symbol(). All the start symbols are
+   * compiled into one parser, a word is parsed once for all of them, e.g.
+   * for "Request" and "Response" of a protocol. The parse_word() accepts
+   * the word when some start symbol generates it and get_matched_symbols()
+   * tells which ones, unless set_target_symbol() chooses one.
+   *
+   * \param[in] symbol_name Name of the start symbol.
+   * \param[in] start_grammar_name Syntax specification containing the start symbol.
+   */
+  void add_start_symbol(const char *symbol_name, const char *start_grammar_name = NULL);
+
+  //! Choose the start symbol the words must match.
+  /**
+   * The parse_word() then accepts only the words the chosen start symbol
+   * generates. The other start symbols are still parsed, so the error
+   * position of a rejected word may be after the one the chosen symbol
+   * alone would give. The search() always uses all the start symbols.
+   *
+   * \param[in] symbol_name Name of one of the start symbols, NULL for any.
+   *   An unknown name makes the parsing fail with an exception.
+   */
+  void set_target_symbol(const char *symbol_name);
+
+  //! Add a nonterminal the parsing recovers on after a syntax error.
+  /**
+   * Optional. Must be called before build_parser(). When no parsing stack
+   * can continue, the parser finds the first position after the last
+   * terminator before the error a recovery symbol may start at, e.g. the
+   * start of the header line with the error. It skips
+   * the input up to the next terminator after the error, e.g. "\r\n", and
+   * continues after it as if the symbol was found there. So all the errors
+   * of a word are found in one pass, see get_errors().
+   *
+   * A word with an error is never accepted, the parse_word() and parse()
+   * return false and get_error_position() gives the first error.
+   *
+   * \param[in] symbol_name Name of the nonterminal.
+   * \param[in] terminator The string every word of the nonterminal ends with.
+   */
+  void add_recovery_symbol(const char *symbol_name, const char *terminator);
+
+  //! Use the active grammar of a registry.
+  /**
+   * Optional. The parser then does not need its own specifications, each
+   * parse_word() uses the grammar published in the registry at the time it
+   * starts. The registry must exist as long as the parser is attached.
+   *
+   * \param[in] registry The registry, NULL to detach.
+   */
+  void attach(BnfRegistry *registry);
+
   //! Process the specifications and build the parser.
+  /**
+   * May be called again after more specifications were added using
+   * add_grammar() or add_referenced_grammars(). The parser is then rebuilt
+   * incrementally, the states not affected by the new rules are reused.
+   * The tokens extracted before keep their numbers, but if the new rules turn
+   * a token into a nonterminal again, the parser is built from scratch.
+   */
   void build_parser(void);
 
   //! Set the reporter to report non-fatal errors
@@ -121,6 +446,11 @@ public:
 
   //! Set the verbose level.
   /**
+   * The messages above the maximum level of the build are never printed,
+   * see the --with-max-log-level option of configure. The debug messages
+   * of each action of the parsing (level 7) are compiled out by default,
+   * unless the library is configured with --enable-debug.
+   *
    * \param[in] level New verbose level.
    */
   void set_verbose_level(unsigned level);
@@ -133,16 +463,269 @@ public:
    * \return True if parsing was successfull.
    *
    * \sa get_parsing_result(), get_error_position(), get_semantic_string()
-   * \warning Must not be called before build_parser().
+   * \warning Must not be called before build_parser(), unless the parser is
+   *   attached to a registry with a grammar published.
    */
   bool parse_word(const std::string& word);
 
+  //! Parse a word in the caller's buffer.
+  /**
+   * Works like parse_word(), but the word is not copied, e.g. a packet
+   * buffer or a part of a mapped file is parsed in place. The positions
+   * of the results are offsets from the data. The semantic string is read
+   * from the buffer, so the buffer must outlive the results: it must not
+   * be changed or released until the next parsing, as long as
+   * get_semantic_string() may be called.
+   *
+   * \param[in] data The first byte of the word.
+   * \param[in] length The length of the word.
+   * \return True if parsing was successfull.
+   */
+  bool parse(const char *data, size_t length);
+
+#if __cplusplus >= 201703L
+  //! Parse a word in the caller's buffer, see parse(const char*, size_t).
+  bool parse(std::string_view word)
+  { return parse(word.data(), word.size()); }
+#endif
+
+  //! Parse the document of an editing session.
+  /**
+   * Works like parse_word(), the parser keeps a copy of the document and
+   * the state of the parsing before each position, so reparse() may parse
+   * it again after an edit. The state takes some tens of bytes per byte of
+   * the document. Any other parsing ends the session.
+   *
+   * \param[in] document The document to be parsed.
+   * \return True if parsing was successfull.
+   */
+  bool parse_document(const std::string& document);
+
+  //! Edit the document of the editing session and parse it again.
+  /**
+   * Replaces the bytes of the document from the offset by the inserted
+   * ones. The parsing continues from the last position before the edit
+   * whose parsing did not look at any byte after the offset, so only the
+   * part from about the edit to the end is parsed, e.g. a keystroke at the
+   * end of a document is parsed in a time independent of its size. The
+   * results are the same as those of parse_document() called for the
+   * edited document.
+   *
+   * When parse_document() was not called, the session started with an
+   * empty document. The parsing starts over when the grammar, the target
+   * symbol, the match mode or the ambiguity policy changed after the last
+   * parsing of the session.
+   *
+   * \param[in] offset The position of the edit.
+   * \param[in] removed_length The number of the bytes removed.
+   * \param[in] inserted The bytes inserted.
+   * \return True if parsing was successfull.
+   * \throw std::out_of_range The bytes removed are not in the document.
+   */
+  bool reparse(size_t offset, size_t removed_length, const std::string& inserted);
+
+  //! Get the document of the editing session, see reparse().
+  const std::string& get_document(void);
+
+  //! Parse many independent words.
+  /**
+   * The results are the same as if parse_word() was called for each word,
+   * but no semantic strings are built. When the whole grammar is regular,
+   * the words are recognized by one DFA, several words in lockstep, with no
+   * set-up for each word. Suitable to validate many short strings, e.g.
+   * URIs or header values.
+   *
+   * The results of get_result_code() and the other functions describing the
+   * last parsing are not defined afterwards.
+   *
+   * \param[in] words The words to be parsed.
+   * \param[out] results The result of each word.
+   */
+  void parse_words(const std::vector<std::string>& words, std::vector<WordResult>& results);
+
   //! Returns the result of the last parsing.
   /**
    * \return True if the last parse_word() was successfull.
    */
   bool get_parsing_result(void);
 
+  //! Find the parts of a buffer the start symbol generates.
+  /**
+   * Works like a grep: finds the leftmost longest non-empty parts of the
+   * buffer generated by the start symbol, which do not overlap. The buffer
+   * is parsed once, from left to right. An attempt starts at each position
+   * the start symbol may start with, and all attempts share the same
+   * parsing stacks.
+   *
+   * \param[in] buffer The buffer to be searched, e.g. a log or a payload.
+   * \param[out] matches The parts found, in the order of their positions.
+   * \return False if a limit was exceeded, see get_result_code(). The
+   *   matches are then incomplete.
+   */
+  bool search(const std::string& buffer, std::vector<Match>& matches);
+
+  //! Find the parts of a buffer the start symbol generates, the buffer is not copied.
+  /**
+   * See search(const std::string&, std::vector<Match>&).
+   */
+  bool search(const char *buffer, size_t length, std::vector<Match>& matches);
+
+  //! Set the limits of the resources used by parse_word().
+  /**
+   * When a limit is exceeded, the parse_word() stops and returns false. The
+   * get_result_code() then tells which limit was exceeded and the
+   * get_error_position() returns the position reached.
+   *
+   * \param[in] limits The new limits.
+   */
+  void set_limits(const BnfLimits& limits);
+
+  //! Enable the quick rejection of the words the grammar cannot generate.
+  /**
+   * The build_parser() derives necessary conditions of the acceptance from
+   * the grammar: the bytes a word may start with and may contain, the
+   * minimal and maximal length and the literals every word contains, e.g.
+   * "SIP/" (ignoring the case). When enabled, parse_word() checks them
+   * first and rejects a word failing them without parsing.
+   *
+   * The result is not affected, but the get_error_position() of a word
+   * rejected by the checks is the position of the failed check: the first
+   * byte not allowed, the maximal length or the end of the word. It may be
+   * after the position the parsing would report. Disabled by default.
+   *
+   * \param[in] enabled True to enable the checks.
+   */
+  void set_prefilter(bool enabled);
+
+  //! Set the part of the word accepted by parse_word().
+  /**
+   * By default the start symbol must generate the whole word. With
+   * Match_Longest or Match_Shortest the parse_word() accepts the word when
+   * the start symbol generates some prefix of it and get_match_length()
+   * returns the length of the longest or the shortest such prefix. This
+   * finds the end of a self-delimiting message in a stream, e.g. pipelined
+   * requests. The parsing goes on only while some derivation may continue;
+   * the semantic string describes the prefix.
+   *
+   * The parse_words() always matches the whole words, the prefilter is not
+   * used with the prefixes.
+   *
+   * \param[in] mode The match mode.
+   */
+  void set_match_mode(MatchMode mode);
+
+  //! Get the length of the prefix accepted by the last parse_word().
+  /**
+   * When the last parse_word() was unsuccessful, the return value is not defined.
+   *
+   * \return The length of the prefix, the word length in the Match_Whole mode.
+   */
+  unsigned get_match_length(void);
+
+  //! Get the start symbols that generate the word accepted by the last parse_word().
+  /**
+   * When the last parse_word() was unsuccessful, the return value is not
+   * defined. The semantic string belongs to the first of the symbols.
+   *
+   * \return The names of the start symbols, in the order they were added.
+   */
+  std::vector<std::string> get_matched_symbols(void);
+
+  //! Set how the ambiguous derivations are handled.
+  /**
+   * By default all derivations of an ambiguous word are kept and the semantic
+   * string lists them in \<ambiguity\> elements. When only one derivation is
+   * needed, e.g. for validation, the others may be dropped as soon as they
+   * are found, so they do not multiply during the rest of the parsing. The
+   * result of parse_word() is not affected.
+   *
+   * With Ambiguity_PreferRule each part of the input keeps the derivation by
+   * the alternative given first in the grammar.
+   *
+   * \param[in] policy The policy.
+   * \param[in] max_ways The number of derivations kept by Ambiguity_KeepN.
+   */
+  void set_ambiguity_policy(AmbiguityPolicy policy, unsigned max_ways = 1);
+
+  //! Get the statistics of the last parsing.
+  /**
+   * Tells why one word takes longer than another, e.g. a wide level or
+   * many ambiguous symbols. The counters are cheap, they are always on.
+   *
+   * \param[out] stats The statistics.
+   */
+  void get_parse_stats(BnfParseStats& stats);
+
+  //! Enable or disable the profiling of the grammar.
+  /**
+   * While enabled, the parsings count the reductions and the path steps of
+   * each rule and the splits of the stack in each state. The counts add up
+   * over the parsings, e.g. of a corpus; enabling clears them. Disabled by
+   * default, the counting costs a memory access per action.
+   *
+   * \param[in] enabled If set, the work is counted.
+   */
+  void set_profiling(bool enabled);
+
+  //! Get the work counted since the profiling was enabled.
+  /**
+   * \param[out] profile The counts mapped to the rules of the grammars.
+   */
+  void get_profile(BnfProfile& profile);
+
+  //! Keep the last events of the parsings for a post-mortem analysis.
+  /**
+   * The shifts, the reductions, the nodes created, the errors and the start
+   * and the end of each parsing are written to a ring of fixed-size records,
+   * the oldest records are overwritten. The ring belongs to this instance,
+   * which is used by one thread at a time, so no lock is taken. A record
+   * costs a few stores and a read of the clock, cheap enough to leave the
+   * recording on under load. Enabling clears the events recorded.
+   *
+   * \param[in] capacity The number of the events kept, 0 disables the recording.
+   */
+  void set_event_recording(unsigned capacity);
+
+  //! Get the events recorded, the oldest first.
+  /**
+   * \param[out] events The events.
+   */
+  void get_events(std::vector<BnfEvent>& events);
+
+  //! Write the events recorded to a binary file.
+  /**
+   * Each event is a record of nine 32-bit little-endian words, the fields
+   * of BnfEvent in their order, the oldest first.
+   *
+   * \param[in] file_name The name of the file.
+   * \return False if the file cannot be written.
+   */
+  bool write_events(const char *file_name);
+
+  //! Read the events written by write_events().
+  /**
+   * \param[in] file_name The name of the file.
+   * \param[out] events The events.
+   * \return False if the file cannot be read or is not a whole number of records.
+   */
+  static bool read_events(const char *file_name, std::vector<BnfEvent>& events);
+
+  //! Returns the result of the last parsing in detail.
+  /**
+   * \return Result_Accepted, Result_Rejected or the limit exceeded.
+   */
+  ResultCode get_result_code(void);
+
+  //! Get all the syntax errors of the last parsing.
+  /**
+   * Without add_recovery_symbol() the parsing stops at the first error, so
+   * there is one error at most. The end of the last error is the length of
+   * the word unless the parsing recovered from it.
+   *
+   * \param[out] errors The errors, in the order of their positions.
+   */
+  void get_errors(std::vector<ErrorSpan>& errors);
+
   //! Get the position of an error occured during the last parsing.
   /**
    * When the last parse_word() was successful, the return value is not defined.
@@ -158,6 +741,131 @@ public:
    * \return Semantic string.
    */
   std::string get_semantic_string(void);
+
+  //! Report the markup of the last parsing to a visitor.
+  /**
+   * Calls the visitor for each marked nonterminal of the derivation
+   * accepted by the last parse_word(), in the order of the input. No string
+   * is built, it is the way to pick a few fields of a message.
+   *
+   * When the last parse_word() was unsuccessful, the calls are not defined.
+   *
+   * \param[in] visitor The visitor.
+   */
+  void visit_semantics(BnfVisitor& visitor);
+
+  //! Request a marked nonterminal to be extracted by get_fields().
+  /**
+   * Optional. Must be called before build_parser(). Once some fields are
+   * requested, the other marks of the grammar are ignored: the semantic
+   * string and the visitor show the fields only, and the rules that cannot
+   * derive a field build no semantic values at all.
+   *
+   * \param[in] mark_name Name of the marked nonterminal, e.g. "callid" or "callid@".
+   * \return The number identifying the field in BnfField::field.
+   */
+  unsigned add_field(const char *mark_name);
+
+  //! Get the fields of the last parsing.
+  /**
+   * Fills the vector with the marked nonterminals of the derivation
+   * accepted by the last parse_word(), in the order of their beginning.
+   * Of an ambiguous part the first derivation containing some field is used. The vector is
+   * cleared first, a vector passed repeatedly keeps its memory.
+   *
+   * When no field was requested, all the marks are given. When the last
+   * parse_word() was unsuccessful, the result is not defined.
+   *
+   * \param[out] fields The fields found.
+   */
+  void get_fields(std::vector<BnfField>& fields);
+
+  //! Get the name of a field.
+  /**
+   * The names of the fields requested by add_field() are known before any
+   * parsing, the other marks once the parser is built. Throws
+   * std::out_of_range if there is no such field.
+   *
+   * \param[in] field The number of BnfField::field.
+   * \return The name of the marked nonterminal, without the "@".
+   */
+  std::string get_field_name(unsigned field);
+};
+
+//! Registry of the active grammar, for long-running processes.
+/**
+ * Allows replacing the grammar without stopping the parsing. The new grammar
+ * is prepared in a separate BnfParser2 instance (a builder) and published.
+ * The parsers attached to the registry pick up the new grammar at the start
+ * of their next parse_word(); a parsing in progress finishes with the grammar
+ * it has started with. The old grammar is deleted when the last parser using
+ * it moves to the new one. Until the grammar is replaced, the parsers do not
+ * lock anything.
+ *
+ * All the methods may be called from any thread. A BnfParser2 instance,
+ * however, must not be used by several threads at once.
+ */
+class BNFPARSER2_EXP_DEFN BnfRegistry
+{
+  class Internals;
+  Internals *m_internals;
+
+  //! Returns the parser of the active grammar, updates the snapshot used by the caller
+  Parser *acquire(GrammarSnapshot *&snapshot);
+
+  //! Releases the snapshot used by a parser
+  void release(GrammarSnapshot *snapshot);
+
+  friend class BnfParser2;
+
+public:
+  //! A constructor.
+  BnfRegistry(void);
+
+  //! A destructor. Waits for the background build to finish.
+  ~BnfRegistry(void);
+
+  //! Build a grammar and make it active.
+  /**
+   * Calls build_parser() of the builder and publishes the result. The builder
+   * must not be used by the caller anymore, the registry deletes it when the
+   * grammar is no longer needed. If build_parser() throws, the builder is
+   * deleted, the exception is passed to the caller and the active grammar
+   * remains unchanged.
+   *
+   * \param[in] builder Parser with the specifications added and the start symbol set.
+   */
+  void publish(BnfParser2 *builder);
+
+  //! Build a grammar in a background thread and make it active.
+  /**
+   * Same as publish(), but returns immediately. The parsers attached to the
+   * registry continue with the active grammar until the build is finished.
+   *
+   * A finished build does not need to be waited for before the next one is
+   * started.
+   *
+   * \param[in] builder Parser with the specifications added and the start symbol set.
+   * \return False if the previous build is still running, the builder is then not used.
+   *
+   * \sa wait()
+   */
+  bool publish_async(BnfParser2 *builder);
+
+  //! Wait for the background build to finish.
+  /**
+   * May be called by several threads at once, each returns when the build
+   * is finished.
+   *
+   * \return False if the build failed, see get_error().
+   */
+  bool wait(void);
+
+  //! Returns the error message of the last failed build.
+  std::string get_error(void);
+
+  //! Returns the number of grammars published so far.
+  unsigned get_generation(void);
 };
 
 #endif
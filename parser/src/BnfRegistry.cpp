@@ -0,0 +1,420 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "Debug.h"
+
+#ifndef BNFPARSER2_EXP_DEFN
+#ifdef _WIN32
+#define BNFPARSER2_EXP_DEFN __declspec(dllexport)
+#else
+#define BNFPARSER2_EXP_DEFN /* empty */
+#endif
+#endif
+
+#include "BnfParser2.h"
+
+/** \brief A published grammar.
+ *
+ *  The builder is kept as long as any parser uses its table.
+ */
+class GrammarSnapshot
+{
+public:
+  //! The parser the grammar was built by
+  BnfParser2 *m_builder;
+
+  //! The number of parsers using the grammar, including the registry itself
+  unsigned m_references;
+
+  GrammarSnapshot(BnfParser2 *builder)
+  : m_builder(builder), m_references(1)
+  {}
+
+  ~GrammarSnapshot()
+  {
+    delete m_builder;
+  }
+};
+
+//! The data of the registry, hidden from the public header
+class BnfRegistry::Internals
+{
+public:
+#ifdef _WIN32
+  CRITICAL_SECTION m_mutex;
+  CRITICAL_SECTION m_join_mutex;
+  HANDLE m_thread;
+#else
+  pthread_mutex_t m_mutex;
+  pthread_mutex_t m_join_mutex;
+  pthread_t m_thread;
+#endif
+
+  //! The active grammar, NULL if nothing was published yet
+  /** Accessed only by get_active() and set_active(), the parsers read it
+   *  without locking the mutex.
+   */
+  GrammarSnapshot *m_active;
+
+  //! The number of grammars published
+  unsigned m_generation;
+
+  //! Set while the background thread exists and is not joined
+  /** Changed with both mutexes locked, the thread is joined with the
+   *  join mutex locked only, so that one thread joins it.
+   */
+  bool m_building;
+
+  //! The builder processed by the background thread, NULL when the build is finished
+  BnfParser2 *m_pending;
+
+  //! The result of the last build
+  bool m_build_ok;
+  std::string m_error;
+
+  Internals(void)
+  : m_active(NULL), m_generation(0), m_building(false), m_pending(NULL), m_build_ok(true)
+  {
+#ifdef _WIN32
+    InitializeCriticalSection(&m_mutex);
+    InitializeCriticalSection(&m_join_mutex);
+#else
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_mutex_init(&m_join_mutex, NULL);
+#endif
+  }
+
+  ~Internals()
+  {
+#ifdef _WIN32
+    DeleteCriticalSection(&m_join_mutex);
+    DeleteCriticalSection(&m_mutex);
+#else
+    pthread_mutex_destroy(&m_join_mutex);
+    pthread_mutex_destroy(&m_mutex);
+#endif
+  }
+
+  void lock(void)
+  {
+#ifdef _WIN32
+    EnterCriticalSection(&m_mutex);
+#else
+    pthread_mutex_lock(&m_mutex);
+#endif
+  }
+
+  void unlock(void)
+  {
+#ifdef _WIN32
+    LeaveCriticalSection(&m_mutex);
+#else
+    pthread_mutex_unlock(&m_mutex);
+#endif
+  }
+
+  //! Serializes the joining and the starting of the background thread
+  /** Locked before the mutex, never while the mutex is locked.
+   */
+  void lock_join(void)
+  {
+#ifdef _WIN32
+    EnterCriticalSection(&m_join_mutex);
+#else
+    pthread_mutex_lock(&m_join_mutex);
+#endif
+  }
+
+  void unlock_join(void)
+  {
+#ifdef _WIN32
+    LeaveCriticalSection(&m_join_mutex);
+#else
+    pthread_mutex_unlock(&m_join_mutex);
+#endif
+  }
+
+  //! Joins the background thread, if any
+  /** Must be called with the join mutex locked and the mutex unlocked.
+   */
+  void join(void)
+  {
+    lock();
+    bool building = m_building;
+    unlock();
+
+    if(!building)
+      return;
+
+#ifdef _WIN32
+    WaitForSingleObject(m_thread, INFINITE);
+    CloseHandle(m_thread);
+#else
+    pthread_join(m_thread, NULL);
+#endif
+    lock();
+    m_building = false;
+    unlock();
+  }
+
+  //! Returns the active grammar without locking the mutex
+  /** The value may be outdated as soon as it is returned, it is used to
+   *  check whether the snapshot of a parser is still active.
+   */
+  GrammarSnapshot *get_active(void)
+  {
+#ifdef _WIN32
+    return static_cast<GrammarSnapshot*>(InterlockedCompareExchangePointer(
+      reinterpret_cast<PVOID volatile*>(&m_active), NULL, NULL));
+#else
+    return __sync_val_compare_and_swap(&m_active,
+      static_cast<GrammarSnapshot*>(NULL), static_cast<GrammarSnapshot*>(NULL));
+#endif
+  }
+
+  //! Replaces the active grammar, must be called with the mutex locked
+  void set_active(GrammarSnapshot *snapshot)
+  {
+#ifdef _WIN32
+    InterlockedExchangePointer(reinterpret_cast<PVOID volatile*>(&m_active), snapshot);
+#else
+    // the exchange is only an acquire barrier, the snapshot must be complete first
+    __sync_synchronize();
+    (void)__sync_lock_test_and_set(&m_active, snapshot);
+#endif
+  }
+
+  //! Decrements the reference count, returns the snapshot if it is to be deleted
+  /** Must be called with the mutex locked. The snapshot is deleted by the caller
+   *  after unlocking, so that the other threads do not wait for it.
+   */
+  GrammarSnapshot *unreference(GrammarSnapshot *snapshot)
+  {
+    if(snapshot != NULL && --snapshot->m_references == 0)
+      return snapshot;
+    return NULL;
+  }
+
+  //! Builds the grammar and swaps it with the active one
+  /** The table is built without the mutex locked, only the swap is locked.
+   */
+  void build_and_swap(BnfParser2 *builder)
+  {
+    try
+    {
+      builder->build_parser();
+    }
+    catch(...)
+    {
+      delete builder;
+      throw;
+    }
+
+    GrammarSnapshot *snapshot = new GrammarSnapshot(builder);
+
+    lock();
+    GrammarSnapshot *old = unreference(get_active());
+    set_active(snapshot);
+    m_generation++;
+    logTrace(LOG_INFO, "grammar " << m_generation << " published");
+    unlock();
+
+    delete old;
+  }
+
+  //! The function of the background thread
+  static void run_build(Internals *internals)
+  {
+    bool build_ok = true;
+    std::string error;
+
+    try
+    {
+      internals->build_and_swap(internals->m_pending);
+    }
+    catch(std::exception& e)
+    {
+      build_ok = false;
+      error = e.what();
+    }
+    catch(...)
+    {
+      build_ok = false;
+      error = "Unknown error";
+    }
+
+    internals->lock();
+    internals->m_pending = NULL;
+    internals->m_build_ok = build_ok;
+    internals->m_error = error;
+    internals->unlock();
+  }
+
+#ifdef _WIN32
+  static DWORD WINAPI build_thread(LPVOID internals)
+  {
+    run_build(static_cast<Internals*>(internals));
+    return 0;
+  }
+#else
+  static void *build_thread(void *internals)
+  {
+    run_build(static_cast<Internals*>(internals));
+    return NULL;
+  }
+#endif
+};
+
+BnfRegistry::BnfRegistry(void)
+{
+  m_internals = new Internals;
+}
+
+BnfRegistry::~BnfRegistry(void)
+{
+  wait();
+  // the parsers still attached would use a deleted registry
+  delete m_internals->unreference(m_internals->get_active());
+  delete m_internals;
+}
+
+void BnfRegistry::publish(BnfParser2 *builder)
+{
+  m_internals->build_and_swap(builder);
+
+  m_internals->lock();
+  m_internals->m_build_ok = true;
+  m_internals->m_error.clear();
+  m_internals->unlock();
+}
+
+bool BnfRegistry::publish_async(BnfParser2 *builder)
+{
+  m_internals->lock_join();
+  m_internals->lock();
+  if(m_internals->m_pending != NULL)
+  {
+    m_internals->unlock();
+    m_internals->unlock_join();
+    return false;
+  }
+  m_internals->unlock();
+
+  // the previous build is finished, but its thread may be not joined yet
+  m_internals->join();
+
+  m_internals->lock();
+  m_internals->m_building = true;
+  m_internals->m_pending = builder;
+  m_internals->unlock();
+
+#ifdef _WIN32
+  m_internals->m_thread = CreateThread(NULL, 0, Internals::build_thread, m_internals, 0, NULL);
+  bool started = (m_internals->m_thread != NULL);
+#else
+  bool started = (pthread_create(&m_internals->m_thread, NULL, Internals::build_thread, m_internals) == 0);
+#endif
+  if(!started)
+  {
+    m_internals->lock();
+    m_internals->m_building = false;
+    m_internals->m_pending = NULL;
+    m_internals->unlock();
+    m_internals->unlock_join();
+
+    delete builder;
+    throw std::runtime_error("Cannot start the build thread");
+  }
+
+  m_internals->unlock_join();
+  return true;
+}
+
+bool BnfRegistry::wait(void)
+{
+  // another waiter may be joining the thread, then this one waits for it
+  m_internals->lock_join();
+  m_internals->join();
+  m_internals->unlock_join();
+
+  m_internals->lock();
+  bool result = m_internals->m_build_ok;
+  m_internals->unlock();
+  return result;
+}
+
+std::string BnfRegistry::get_error(void)
+{
+  m_internals->lock();
+  std::string result = m_internals->m_error;
+  m_internals->unlock();
+  return result;
+}
+
+unsigned BnfRegistry::get_generation(void)
+{
+  m_internals->lock();
+  unsigned result = m_internals->m_generation;
+  m_internals->unlock();
+  return result;
+}
+
+Parser *BnfRegistry::acquire(GrammarSnapshot *&snapshot)
+{
+  GrammarSnapshot *old = NULL;
+
+  // the caller holds a reference to its snapshot, so the snapshot cannot be
+  // deleted and another one created at its address; while it is active the
+  // parsers do not wait for each other
+  if(snapshot != NULL && snapshot == m_internals->get_active())
+    return snapshot->m_builder->m_core_parser;
+
+  m_internals->lock();
+  GrammarSnapshot *active = m_internals->get_active();
+  if(snapshot != active)
+  {
+    old = m_internals->unreference(snapshot);
+    snapshot = active;
+    if(snapshot != NULL)
+      snapshot->m_references++;
+  }
+  m_internals->unlock();
+
+  // the last parser leaving the old grammar deletes it
+  delete old;
+  return snapshot != NULL ? snapshot->m_builder->m_core_parser : NULL;
+}
+
+void BnfRegistry::release(GrammarSnapshot *snapshot)
+{
+  m_internals->lock();
+  GrammarSnapshot *old = m_internals->unreference(snapshot);
+  m_internals->unlock();
+
+  delete old;
+}
+
+// end of file
@@ -34,15 +34,23 @@
 #define LOG_DEBUG    7 // debug-level messages
 #define LOG_TRACE    8 // function call tracing
 
+// The levels above LOG_MAX_LEVEL are compiled out, their conditions are
+// constant. E.g. -DLOG_MAX_LEVEL=LOG_INFO removes the traces of each action
+// from the parsing; no global is read and no operand is computed for them.
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_TRACE
+#endif
+
 extern int logCurrentLevel;
 
 inline void logSetLevel( const int level )
 { logCurrentLevel = level; }
 
-#define logIsEnabledFor(level) level <= logCurrentLevel
+#define logIsEnabledFor(level) \
+  ((level) <= LOG_MAX_LEVEL && (level) <= logCurrentLevel)
 
 #define logTrace(level, params) \
-  if(level <= logCurrentLevel) std::cerr << params << std::endl; else (void)0
+  if(logIsEnabledFor(level)) std::cerr << params << std::endl; else (void)0
 
 #endif /* DEBUG_H */
 
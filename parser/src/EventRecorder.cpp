@@ -0,0 +1,142 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <fstream>
+
+#include "EventRecorder.h"
+
+//! The number of the 32-bit words of a record in a file
+static const unsigned record_words = 9;
+
+//! Returns the wall-clock time in seconds and microseconds
+/** The time is split, so that it does not overflow where long has 32 bits.
+ */
+static void current_time(unsigned long& seconds, unsigned long& microseconds)
+{
+#ifdef _WIN32
+  FILETIME now;
+  ULARGE_INTEGER ticks; // 100-nanosecond intervals
+  GetSystemTimeAsFileTime(&now);
+  ticks.LowPart = now.dwLowDateTime;
+  ticks.HighPart = now.dwHighDateTime;
+  seconds = static_cast<unsigned long>(ticks.QuadPart / 10000000);
+  microseconds = static_cast<unsigned long>(ticks.QuadPart / 10 % 1000000);
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  seconds = now.tv_sec;
+  microseconds = now.tv_usec;
+#endif
+}
+
+void EventRecorder::set_capacity(unsigned capacity)
+{
+  std::vector<BnfEvent>(capacity).swap(m_ring);
+  m_next = 0;
+  m_count = 0;
+  current_time(m_start_seconds, m_start_microseconds);
+}
+
+void EventRecorder::get_time(unsigned& seconds, unsigned& microseconds) const
+{
+  unsigned long now_seconds, now_microseconds;
+  current_time(now_seconds, now_microseconds);
+
+  seconds = now_seconds - m_start_seconds;
+  if(now_microseconds >= m_start_microseconds)
+    microseconds = now_microseconds - m_start_microseconds;
+  else
+  {
+    seconds--;
+    microseconds = now_microseconds + 1000000 - m_start_microseconds;
+  }
+}
+
+void EventRecorder::get_events(std::vector<BnfEvent>& events) const
+{
+  events.clear();
+  // until the ring is full the oldest record is the first one
+  unsigned first = (m_count < m_ring.size()) ? 0 : m_next;
+  for(unsigned k = 0; k < m_count; k++)
+    events.push_back(m_ring[(first + k) % m_ring.size()]);
+}
+
+bool EventRecorder::write(const std::string& file_name) const
+{
+  std::ofstream file(file_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  std::vector<BnfEvent> events;
+  get_events(events);
+
+  for(unsigned k = 0; k < events.size() && file; k++)
+  {
+    const BnfEvent& event = events[k];
+    unsigned words[record_words] = { event.seconds, event.microseconds, event.type, event.level,
+      static_cast<unsigned>(event.state), static_cast<unsigned>(event.rule),
+      event.node, event.node_level, static_cast<unsigned>(event.value) };
+
+    // little-endian, whatever the byte order of the machine
+    char bytes[record_words * 4];
+    for(unsigned l = 0; l < record_words; l++)
+      for(unsigned m = 0; m < 4; m++)
+        bytes[4*l + m] = static_cast<char>((words[l] >> (8*m)) & 0xFF);
+    file.write(bytes, sizeof(bytes));
+  }
+  return !file.fail();
+}
+
+bool EventRecorder::read(const std::string& file_name, std::vector<BnfEvent>& events)
+{
+  std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+  events.clear();
+  if(!file)
+    return false;
+
+  char bytes[record_words * 4];
+  while(file.read(bytes, sizeof(bytes)))
+  {
+    unsigned words[record_words];
+    for(unsigned l = 0; l < record_words; l++)
+    {
+      words[l] = 0;
+      for(unsigned m = 0; m < 4; m++)
+        words[l] |= static_cast<unsigned>(static_cast<unsigned char>(bytes[4*l + m])) << (8*m);
+    }
+
+    events.push_back(BnfEvent());
+    BnfEvent& event = events.back();
+    event.seconds = words[0];
+    event.microseconds = words[1];
+    event.type = words[2];
+    event.level = words[3];
+    event.state = static_cast<int>(words[4]);
+    event.rule = static_cast<int>(words[5]);
+    event.node = words[6];
+    event.node_level = words[7];
+    event.value = static_cast<int>(words[8]);
+  }
+  // a part of a record remains
+  return file.gcount() == 0;
+}
+
+// end of file
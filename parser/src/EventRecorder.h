@@ -0,0 +1,102 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#ifndef _EVENTRECORDER_
+#define _EVENTRECORDER_
+
+#include <string>
+#include <vector>
+
+#include "BnfParser2.h"
+
+/** \brief The last events of the parsings, kept in a ring of fixed-size records.
+ *
+ *  Each parser owns its recorder and a parser is used by one thread at a
+ *  time, so the records are written without any lock. When the ring is full
+ *  the oldest record is overwritten. The recording is disabled by default,
+ *  record() then returns after a test of the capacity.
+ */
+class EventRecorder
+{
+public:
+  EventRecorder(void)
+  : m_next(0), m_count(0), m_start_seconds(0), m_start_microseconds(0)
+  {}
+
+  //! Sets the number of the events kept and clears the ring, 0 disables the recording
+  void set_capacity(unsigned capacity);
+
+  //! Returns true if the events are recorded
+  bool enabled(void) const
+  {
+    return !m_ring.empty();
+  }
+
+  //! Records an event, if enabled
+  void record(BnfEvent::Type type, unsigned level, int state, int rule,
+    unsigned node, unsigned node_level, int value)
+  {
+    if(m_ring.empty())
+      return;
+
+    BnfEvent& event = m_ring[m_next];
+    get_time(event.seconds, event.microseconds);
+    event.type = type;
+    event.level = level;
+    event.state = state;
+    event.rule = rule;
+    event.node = node;
+    event.node_level = node_level;
+    event.value = value;
+
+    if(++m_next == m_ring.size())
+      m_next = 0;
+    if(m_count < m_ring.size())
+      m_count++;
+  }
+
+  //! Returns the events kept, the oldest first
+  void get_events(std::vector<BnfEvent>& events) const;
+
+  //! Writes the events kept to a binary file, see BnfParser2::write_events()
+  bool write(const std::string& file_name) const;
+
+  //! Reads the events written by write()
+  static bool read(const std::string& file_name, std::vector<BnfEvent>& events);
+
+private:
+  //! The records, empty if the recording is disabled
+  std::vector<BnfEvent> m_ring;
+
+  //! The record written next
+  unsigned m_next;
+
+  //! The number of the records written, up to the capacity
+  unsigned m_count;
+
+  //! The time the recording was enabled
+  unsigned long m_start_seconds;
+  unsigned long m_start_microseconds;
+
+  //! Returns the time since the recording was enabled
+  void get_time(unsigned& seconds, unsigned& microseconds) const;
+};
+
+#endif  //_EVENTRECORDER_
+
+// end of file
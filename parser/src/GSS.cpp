@@ -19,59 +19,263 @@
 
 #include "GSS.h"
 
-std::vector<std::pair<GSS::StateIdent, std::string> > GSS::find_reachable(const GSS::StateIdent& from, unsigned length, const GSS::SymbolIdent& first_part)
+const GSS::ValueIdent GSS::no_markup;
+
+//! The multiplier of the hash of the markup events
+static const unsigned long hash_multiplier = 16777619UL;
+
+void GSS::add_to_hash(ValueNode& node, int type, int mark, unsigned offset)
 {
-  unsigned i;
-  std::set<std::pair<unsigned, std::string> > symbols;
-  std::set<std::pair<std::pair<unsigned, unsigned>, std::string> > states;
-  
-  std::set<std::pair<std::pair<unsigned, unsigned>, std::string> >::iterator states_iter;
-  std::set<std::pair<unsigned, std::string> >::iterator symbols_iter;
-  
-  std::vector<std::pair<GSS::StateIdent, std::string> > retval;
-  std::string reduce_string;
-  
-  bool now_states = true;
-  if(length > 0)
-  {
-    states.insert(std::make_pair(std::make_pair(from.level, from.id), get_semantic_string(first_part)));
-    length = 2*(length - 1);
-  }
-  else
-    states.insert(std::make_pair(std::make_pair(from.level, from.id), ""));
-  
-  while(length > 0)
+  unsigned long code = (static_cast<unsigned long>(offset) << 3) + type
+    + static_cast<unsigned long>(mark + 1) * 2654435761UL;
+  node.hash = node.hash * hash_multiplier + code;
+  node.power *= hash_multiplier;
+  node.event_count++;
+}
+
+void GSS::add_to_hash(ValueNode& node, ValueIdent value) const
+{
+  if(value == no_markup)
+    return;
+
+  const ValueNode& child = m_values[value];
+  node.hash = node.hash * child.power + child.hash;
+  node.power *= child.power;
+  node.event_count += child.event_count;
+}
+
+GSS::ValueIdent GSS::create_value(int type, int mark, unsigned begin, unsigned end,
+  unsigned first_child, unsigned child_count)
+{
+  ValueNode node;
+  unsigned k;
+
+  node.type = type;
+  node.mark = mark;
+  node.begin = begin;
+  node.end = end;
+  node.first_child = first_child;
+  node.child_count = child_count;
+  node.event_count = 0;
+  node.hash = 0;
+  node.power = 1;
+
+  // the events are those get_semantics() gives
+  switch(type)
   {
-    if(now_states)
+  case ValueNode::Value_Sequence:
+    for(k = 0; k < child_count; k++)
+      add_to_hash(node, m_value_links[first_child + k]);
+    break;
+  case ValueNode::Value_Mark:
+    add_to_hash(node, MarkupEvent::Event_Enter, mark, begin);
+    if(child_count != 0)
+      add_to_hash(node, m_value_links[first_child]);
+    add_to_hash(node, MarkupEvent::Event_Leave, mark, end);
+    break;
+  case ValueNode::Value_Ambiguity:
+    add_to_hash(node, MarkupEvent::Event_AmbiguityBegin, -1, begin);
+    for(k = 0; k < child_count; k++)
     {
-      symbols.clear();
-      for(states_iter = states.begin(); states_iter != states.end(); states_iter++)
-        for(i = 0;
-            i < m_state_levels.at(states_iter->first.first).at(states_iter->first.second).successors.size();
-            i++)
-          symbols.insert(std::make_pair(m_state_levels.at(states_iter->first.first)
-                            .at(states_iter->first.second).successors.at(i).id,
-                            states_iter->second));
+      add_to_hash(node, MarkupEvent::Event_AlternativeBegin, -1, begin);
+      add_to_hash(node, m_value_links[first_child + k]);
+      add_to_hash(node, MarkupEvent::Event_AlternativeEnd, -1, end);
     }
-    else
+    add_to_hash(node, MarkupEvent::Event_AmbiguityEnd, -1, end);
+    break;
+  }
+
+  m_values.push_back(node);
+  m_semantic_bytes += sizeof(ValueNode) + child_count * sizeof(ValueIdent);
+  return m_values.size() - 1;
+}
+
+GSS::ValueIdent GSS::create_mark(int mark, unsigned begin, unsigned end, ValueIdent child)
+{
+  unsigned first_child = m_value_links.size();
+  if(child != no_markup)
+    m_value_links.push_back(child);
+  return create_value(ValueNode::Value_Mark, mark, begin, end, first_child,
+    m_value_links.size() - first_child);
+}
+
+GSS::ValueIdent GSS::create_sequence(const std::vector<ValueIdent>& children)
+{
+  unsigned first_child = m_value_links.size();
+  ValueIdent last = no_markup;
+
+  for(unsigned k = 0; k < children.size(); k++)
+    if(children[k] != no_markup)
     {
-      states.clear();
-      for(symbols_iter = symbols.begin(); symbols_iter != symbols.end(); symbols_iter++)
-        for(i = 0;
-            i < m_symbol_nodes.at(symbols_iter->first).successors.size();
-            i++)
-          states.insert(std::make_pair(std::make_pair(m_symbol_nodes.at(symbols_iter->first).successors.at(i).level,
-                                       m_symbol_nodes.at(symbols_iter->first).successors.at(i).id),
-                                       get_semantic_string(SymbolIdent(symbols_iter->first)) + symbols_iter->second));
+      m_value_links.push_back(children[k]);
+      last = children[k];
     }
-    length--;
-    now_states = !now_states;
+
+  // a single value is not wrapped
+  if(m_value_links.size() - first_child < 2)
+  {
+    m_value_links.resize(first_child);
+    return last;
   }
 
-  for(states_iter = states.begin(); states_iter != states.end(); states_iter++)
-    retval.push_back(std::make_pair(StateIdent(states_iter->first.first, states_iter->first.second), states_iter->second));
- 
-  return retval;
+  return create_value(ValueNode::Value_Sequence, -1, m_values[m_value_links[first_child]].begin,
+    m_values[last].end, first_child, m_value_links.size() - first_child);
+}
+
+GSS::ValueIdent GSS::get_value(const SymbolIdent& symbol, unsigned begin, unsigned end)
+{
+  SymbolNode& node = m_symbol_nodes[symbol.id];
+
+  if(node.other_values.empty())
+    return node.semantic_value;
+
+  // the ambiguity is created once for all the reductions passing the node
+  if(node.ambiguity == no_markup)
+  {
+    unsigned first_child = m_value_links.size();
+    m_value_links.push_back(node.semantic_value);
+    m_value_links.insert(m_value_links.end(), node.other_values.begin(), node.other_values.end());
+    node.ambiguity = create_value(ValueNode::Value_Ambiguity, -1, begin, end, first_child,
+      node.other_values.size() + 1);
+    m_ambiguity_symbols.push_back(symbol.id);
+  }
+  return node.ambiguity;
+}
+
+GSS::Checkpoint GSS::get_checkpoint(void) const
+{
+  Checkpoint checkpoint;
+  checkpoint.symbols = m_symbol_nodes.size();
+  checkpoint.values = m_values.size();
+  checkpoint.value_links = m_value_links.size();
+  checkpoint.ambiguities = m_ambiguity_symbols.size();
+  checkpoint.state_count = m_state_count;
+  checkpoint.edge_count = m_edge_count;
+  checkpoint.semantic_bytes = m_semantic_bytes;
+  checkpoint.max_level_width = m_max_level_width;
+  checkpoint.ambiguous_count = m_ambiguous_count;
+  return checkpoint;
+}
+
+void GSS::truncate(const Checkpoint& checkpoint, unsigned level, size_t length)
+{
+  // a symbol kept may have got its ambiguity value later
+  while(m_ambiguity_symbols.size() > checkpoint.ambiguities)
+  {
+    unsigned symbol = m_ambiguity_symbols.back();
+    m_ambiguity_symbols.pop_back();
+    if(symbol < checkpoint.symbols && m_symbol_nodes[symbol].ambiguity != no_markup
+      && m_symbol_nodes[symbol].ambiguity >= checkpoint.values)
+      m_symbol_nodes[symbol].ambiguity = no_markup;
+  }
+
+  m_symbol_nodes.erase(m_symbol_nodes.begin() + checkpoint.symbols, m_symbol_nodes.end());
+  m_values.erase(m_values.begin() + checkpoint.values, m_values.end());
+  m_value_links.erase(m_value_links.begin() + checkpoint.value_links, m_value_links.end());
+
+  for(size_t k = level; k < m_state_levels.size(); k++)
+    m_state_levels[k].clear();
+  m_length = length + 1;
+  m_state_levels.resize(m_length);
+
+  m_state_count = checkpoint.state_count;
+  m_edge_count = checkpoint.edge_count;
+  m_semantic_bytes = checkpoint.semantic_bytes;
+  m_max_level_width = checkpoint.max_level_width;
+  m_ambiguous_count = checkpoint.ambiguous_count;
+}
+
+bool GSS::values_equal(ValueIdent first, ValueIdent second) const
+{
+  if(first == second)
+    return true;
+  if(first == no_markup || second == no_markup)
+    return false;
+
+  const ValueNode& first_node = m_values[first];
+  const ValueNode& second_node = m_values[second];
+  if(first_node.event_count != second_node.event_count || first_node.hash != second_node.hash)
+    return false;
+
+  // the same hash, the events are compared to be sure
+  Semantics first_events, second_events;
+  get_semantics(first, first_events);
+  get_semantics(second, second_events);
+  return first_events == second_events;
+}
+
+void GSS::get_semantics(ValueIdent value, Semantics& semantics, bool first_way) const
+{
+  if(value == no_markup)
+    return;
+
+  // the values may be nested deeply, the stack holds the value and the next step in it
+  std::vector<std::pair<ValueIdent, unsigned> >& stack = m_walk_stack;
+  stack.clear();
+  stack.push_back(std::make_pair(value, 0U));
+
+  while(!stack.empty())
+  {
+    const ValueNode& node = m_values[stack.back().first];
+    unsigned step = stack.back().second++;
+
+    switch(node.type)
+    {
+    case ValueNode::Value_Sequence:
+      if(step < node.child_count)
+        stack.push_back(std::make_pair(m_value_links[node.first_child + step], 0U));
+      else
+        stack.pop_back();
+      break;
+
+    case ValueNode::Value_Mark:
+      if(step == 0)
+      {
+        semantics.push_back(MarkupEvent(MarkupEvent::Event_Enter, node.mark, node.begin));
+        if(node.child_count != 0)
+          stack.push_back(std::make_pair(m_value_links[node.first_child], 0U));
+      }
+      else
+      {
+        semantics.push_back(MarkupEvent(MarkupEvent::Event_Leave, node.mark, node.end));
+        stack.pop_back();
+      }
+      break;
+
+    case ValueNode::Value_Ambiguity:
+      if(first_way)
+      {
+        // the first derivation with some markup stands for the whole ambiguity
+        stack.pop_back();
+        for(unsigned k = 0; k < node.child_count; k++)
+          if(m_value_links[node.first_child + k] != no_markup)
+          {
+            stack.push_back(std::make_pair(m_value_links[node.first_child + k], 0U));
+            break;
+          }
+        break;
+      }
+
+      // each child takes two steps, the begin and the end of the alternative
+      if(step == 0)
+        semantics.push_back(MarkupEvent(MarkupEvent::Event_AmbiguityBegin, -1, node.begin));
+      else if(step <= 2 * node.child_count && step % 2 == 1)
+      {
+        semantics.push_back(MarkupEvent(MarkupEvent::Event_AlternativeBegin, -1, node.begin));
+        // one of the alternatives may have no markup
+        if(m_value_links[node.first_child + step / 2] != no_markup)
+          stack.push_back(std::make_pair(m_value_links[node.first_child + step / 2], 0U));
+      }
+      else if(step <= 2 * node.child_count)
+        semantics.push_back(MarkupEvent(MarkupEvent::Event_AlternativeEnd, -1, node.end));
+      else
+      {
+        semantics.push_back(MarkupEvent(MarkupEvent::Event_AmbiguityEnd, -1, node.end));
+        stack.pop_back();
+      }
+      break;
+    }
+  }
 }
 
 std::vector<GSS::StateIdent> GSS::find_state(size_t level, int label)
@@ -119,7 +323,7 @@ int main()
   
   st = graph.create_state(0, 64);
   
-  sy = graph.create_symbol(-64, "test");
+  sy = graph.create_symbol(-64);
   
   graph.add_successor_to_symbol(sy, st);
   
@@ -17,6 +17,7 @@
  * $Id$
  */
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <stdexcept>
@@ -56,6 +57,58 @@ public:
     :id(nothing){}
   };
 
+  //! One event of the markup of a semantic value
+  /** The semantic values do not contain the input text, only the positions
+   *  of the marked nonterminals and of the ambiguities inside the input
+   *  spanned by the value.
+   */
+  class MarkupEvent
+  {
+  public:
+    enum Type
+    {
+      Event_Enter,              //!< the start of a marked nonterminal
+      Event_Leave,              //!< the end of a marked nonterminal
+      Event_AmbiguityBegin,     //!< the start of the derivations of an ambiguous symbol
+      Event_AlternativeBegin,   //!< the start of one derivation
+      Event_AlternativeEnd,     //!< the end of one derivation
+      Event_AmbiguityEnd        //!< the end of the derivations
+    };
+
+    int type;         //!< The type of the event
+    int mark;         //!< The marked nonterminal, -1 for the ambiguity events
+    unsigned offset;  //!< The position in the input
+
+    MarkupEvent(int _type, int _mark, unsigned _offset)
+    :type(_type), mark(_mark), offset(_offset){}
+
+    friend bool operator<(const MarkupEvent & first, const MarkupEvent & second)
+    {
+      if(first.offset != second.offset)
+        return first.offset < second.offset;
+      if(first.type != second.type)
+        return first.type < second.type;
+      return first.mark < second.mark;
+    }
+
+    friend bool operator==(const MarkupEvent & first, const MarkupEvent & second)
+    {
+      return first.offset == second.offset && first.type == second.type && first.mark == second.mark;
+    }
+  };
+
+  //! The events of a semantic value in the order of the input, see get_semantics()
+  typedef std::vector<MarkupEvent> Semantics;
+
+  //! This type is used for identifying semantic values
+  /** A value is a node linking the values it consists of, so it takes the
+   *  same memory at any nesting level. The value #no_markup stands for any
+   *  part of the input without marked nonterminals.
+   */
+  typedef unsigned ValueIdent;
+
+  static const ValueIdent no_markup = UINT_MAX;
+
   friend bool operator<(const StateIdent & first, const StateIdent & second);
   
   friend bool operator==(const StateIdent & first, const StateIdent & second);
@@ -78,24 +131,39 @@ private:
   {
   public:
     int symbol; //!< Grammar symbol
-    std::set<std::string> semantic_value; //!< The portion of input generated by the symbol
+    int rule; //!< The rule the semantic value was derived by, -1 for terminals
+    ValueIdent semantic_value; //!< The markup of the portion of input generated by the symbol
+    std::vector<ValueIdent> other_values; //!< The other semantic values of an ambiguous symbol
     std::vector<StateIdent> successors; //!< Identifiers of the succeeding state nodes
-    SymbolNode(int _symbol, const std::string& _semantic) //!< Constructor takes the symbol and its semantic value
-    :symbol(_symbol)
-    {
-      semantic_value.insert(_semantic);
-    }
-  
-    //! Adds a new semantic value to the symbol node
-    void add_value(const std::string& val)
-    {
-      semantic_value.insert(val);
-    }
-    //! Checks if the semantics is already stored in the symbol node
-    bool has_semantics(const std::string& val)
+    ValueIdent ambiguity; //!< The ambiguity value of all the semantic values, if created
+    bool ambiguous; //!< Set if several derivations were packed into the node
+    SymbolNode(int _symbol, ValueIdent _semantic, int _rule) //!< Constructor takes the symbol, its semantic value and rule
+    :symbol(_symbol), rule(_rule), semantic_value(_semantic), ambiguity(no_markup), ambiguous(false)
+    {}
+  };
+
+  //! The class representing semantic values
+  /** The input spanned is given by the positions, the text is not copied.
+   */
+  class ValueNode
+  {
+  public:
+    enum Type
     {
-      return semantic_value.count(val) != 0;
-    }
+      Value_Sequence,   //!< the concatenation of the children
+      Value_Mark,       //!< a marked nonterminal, the child is its value
+      Value_Ambiguity   //!< the children are the derivations of one part of the input
+    };
+
+    int type;             //!< The type of the value
+    int mark;             //!< The marked nonterminal of Value_Mark, -1 otherwise
+    unsigned begin;       //!< The position the value starts at
+    unsigned end;         //!< The position the value ends at
+    unsigned first_child; //!< The index of the first child in #m_value_links
+    unsigned child_count; //!< The number of the children
+    unsigned event_count; //!< The number of the events of the value
+    unsigned long hash;   //!< The hash of the events, equal values have equal hashes
+    unsigned long power;  //!< The hash multiplier raised to #event_count
   };
   
   //! Stores all the symbol nodes
@@ -104,29 +172,203 @@ private:
   //! Each state level is a vector of state nodes
   std::vector<std::vector<StateNode> > m_state_levels;
 
+  //! Stores all the semantic values
+  std::vector<ValueNode> m_values;
+
+  //! The children of the semantic values
+  std::vector<ValueIdent> m_value_links;
+
+  //! The symbol nodes whose ambiguity value was created, in the order of creation
+  std::vector<unsigned> m_ambiguity_symbols;
+
+  //! The stack of get_semantics(), kept to reuse its memory
+  mutable std::vector<std::pair<ValueIdent, unsigned> > m_walk_stack;
+
+  //! Creates a semantic value, the children are given by the range of #m_value_links
+  ValueIdent create_value(int type, int mark, unsigned begin, unsigned end,
+    unsigned first_child, unsigned child_count);
+
+  //! Appends the events of a value to the hash of a value being created
+  void add_to_hash(ValueNode& node, ValueIdent value) const;
+
+  //! Appends one event to the hash of a value being created
+  static void add_to_hash(ValueNode& node, int type, int mark, unsigned offset);
+
   //! The length of the word
   size_t m_length;
+
+  //! The number of state nodes in all the levels
+  unsigned long m_state_count;
+
+  //! The number of edges (successors of both the state and the symbol nodes)
+  unsigned long m_edge_count;
+
+  //! The total size of the semantic values stored
+  unsigned long m_semantic_bytes;
+
+  //! The largest number of the state nodes within one level
+  unsigned long m_max_level_width;
+
+  //! The number of the symbol nodes with several derivations
+  unsigned long m_ambiguous_count;
+
+  //! The maximum number of semantic values per symbol node, 0 for unlimited
+  unsigned m_max_values;
+
+  //! If set, the value derived by the rule with the lowest number is kept
+  bool m_prefer_rule;
   
 public:
   //! Constructor creates an empty GSS, must be initialised before use!
   GSS(void)
-  :m_length(0)
+  :m_length(0), m_state_count(0), m_edge_count(0), m_semantic_bytes(0),
+   m_max_level_width(0), m_ambiguous_count(0), m_max_values(0), m_prefer_rule(false)
   {}
+
+  //! Sets how many semantic values (ambiguous derivations) the symbol nodes keep
+  /** When max_values is 0, all the values are kept. When prefer_rule is set,
+   *  only one value is kept: the one derived by the rule with the lowest number,
+   *  i.e. the alternative given first in the grammar.
+   */
+  void set_ambiguity_policy(unsigned max_values, bool prefer_rule)
+  {
+    m_max_values = prefer_rule ? 1 : max_values;
+    m_prefer_rule = prefer_rule;
+  }
+
+  //! Returns the maximum number of semantic values per symbol node, 0 for unlimited
+  unsigned get_max_values(void) const
+  {
+    return m_max_values;
+  }
   
+  //! The sizes of the GSS at some moment of the parsing, see truncate()
+  class Checkpoint
+  {
+  public:
+    size_t symbols;                 //!< The number of the symbol nodes
+    size_t values;                  //!< The number of the semantic values
+    size_t value_links;             //!< The number of the children of the values
+    size_t ambiguities;             //!< The number of the ambiguity values created lazily
+    unsigned long state_count;      //!< The number of the state nodes
+    unsigned long edge_count;       //!< The number of the edges
+    unsigned long semantic_bytes;   //!< The size of the semantic values
+    unsigned long max_level_width;  //!< The largest number of the state nodes within one level
+    unsigned long ambiguous_count;  //!< The number of the symbol nodes with several derivations
+    Checkpoint(void)
+    :symbols(0), values(0), value_links(0), ambiguities(0),
+     state_count(0), edge_count(0), semantic_bytes(0), max_level_width(0), ambiguous_count(0)
+    {}
+  };
+
   //! Resets the GSS, sets the new length of the word
   void reset(size_t length)
   {
     m_symbol_nodes.clear();
     m_state_levels.clear();
+    m_values.clear();
+    m_value_links.clear();
+    m_ambiguity_symbols.clear();
     m_length = length + 1; //0 <= index <= length
     m_state_levels.resize(m_length);
+    m_state_count = 0;
+    m_edge_count = 0;
+    m_semantic_bytes = 0;
+    m_max_level_width = 0;
+    m_ambiguous_count = 0;
+  }
+
+  //! Returns the sizes of the GSS now
+  Checkpoint get_checkpoint(void) const;
+
+  //! Removes the nodes and the values created after the checkpoint
+  /** The levels from the given one are cleared, the nodes below it must not
+   *  have been changed after the checkpoint. Sets the new length of the word.
+   */
+  void truncate(const Checkpoint& checkpoint, unsigned level, size_t length);
+
+  //! Returns the number of the state and the symbol nodes
+  unsigned long get_node_count(void) const
+  {
+    return m_state_count + m_symbol_nodes.size();
+  }
+
+  //! Returns the number of the state nodes
+  unsigned long get_state_count(void) const
+  {
+    return m_state_count;
+  }
+
+  //! Returns the number of the symbol nodes
+  unsigned long get_symbol_count(void) const
+  {
+    return m_symbol_nodes.size();
+  }
+
+  //! Returns the number of the edges
+  unsigned long get_edge_count(void) const
+  {
+    return m_edge_count;
+  }
+
+  //! Returns the largest number of the state nodes within one level
+  unsigned long get_max_level_width(void) const
+  {
+    return m_max_level_width;
+  }
+
+  //! Returns the number of the symbol nodes with several derivations
+  unsigned long get_ambiguous_count(void) const
+  {
+    return m_ambiguous_count;
+  }
+
+  //! Records that another derivation was packed into the symbol node
+  void mark_ambiguous(const SymbolIdent& symbol)
+  {
+    SymbolNode& node = m_symbol_nodes[symbol.id];
+    if(!node.ambiguous)
+    {
+      node.ambiguous = true;
+      m_ambiguous_count++;
+    }
+  }
+
+  //! Returns the total size of the semantic values stored
+  unsigned long get_semantic_bytes(void) const
+  {
+    return m_semantic_bytes;
   }
 
+  //! Creates the value of a marked nonterminal spanning the input from begin to end
+  /** The child is the value of the nonterminal.
+   */
+  ValueIdent create_mark(int mark, unsigned begin, unsigned end, ValueIdent child);
+
+  //! Returns the concatenation of the values
+  /** No value is created when at most one of them contains some markup.
+   */
+  ValueIdent create_sequence(const std::vector<ValueIdent>& children);
+
+  //! Returns the semantic values of the symbol node spanning the input from begin to end
+  /** Several values are given as one ambiguity value.
+   */
+  ValueIdent get_value(const SymbolIdent& symbol, unsigned begin, unsigned end);
+
+  //! Checks if the values consist of the same events
+  bool values_equal(ValueIdent first, ValueIdent second) const;
+
+  //! Appends the events of the value to the semantics
+  /** If first_way is set, an ambiguity gives the events of its first
+   *  derivation with some markup only, without the ambiguity events.
+   */
+  void get_semantics(ValueIdent value, Semantics& semantics, bool first_way = false) const;
+
 
   //! Creates a symbol node with the specified label
-  SymbolIdent create_symbol(int _symbol, const std::string& _sem_val)
+  SymbolIdent create_symbol(int _symbol, ValueIdent _sem_val = no_markup, int _rule = -1)
   {
-    m_symbol_nodes.push_back(SymbolNode(_symbol, _sem_val));
+    m_symbol_nodes.push_back(SymbolNode(_symbol, _sem_val, _rule));
     return SymbolIdent(m_symbol_nodes.size() - 1);
   }
   
@@ -137,6 +379,8 @@ public:
       throw std::out_of_range("Invalid level");
       
     m_state_levels.at(_level).push_back(StateNode(_label));
+    m_state_count++;
+    m_max_level_width = std::max<unsigned long>(m_max_level_width, m_state_levels[_level].size());
     return StateIdent(_level, m_state_levels.at(_level).size() - 1);
   }
 
@@ -149,6 +393,7 @@ public:
       throw std::out_of_range("Invalid symbol node");
       
     m_state_levels.at(whose.level).at(whose.id).successors.push_back(which);
+    m_edge_count++;
   }
 
   //! Makes state node which successor of symbol node whose
@@ -160,6 +405,7 @@ public:
       throw std::out_of_range("Invalid symbol node");
       
     m_symbol_nodes.at(whose.id).successors.push_back(which);
+    m_edge_count++;
   }
 
   //! Returns the label of the specified state node
@@ -180,12 +426,15 @@ public:
     return m_symbol_nodes[which.id].symbol;
   }
 
-  //! Returns the vector of state nodes reachable from the from state node reducing by certain rule length
-  std::vector<std::pair<GSS::StateIdent, std::string> > find_reachable(const GSS::StateIdent& from, unsigned length, const GSS::SymbolIdent& first_part);
-
   //! Returns the vector of state nodes with the specified label within the specified level 
   std::vector<GSS::StateIdent> find_state(size_t level, int label);
   
+  //! Returns the number of the state nodes within the level, see StateIdent::id
+  size_t get_level_size(unsigned level) const
+  {
+    return m_state_levels.at(level).size();
+  }
+
   //! Checks if the state level specified by the argument is empty
   bool state_level_empty(unsigned level)
   {
@@ -207,13 +456,13 @@ public:
   }
 
   //! Returns the successors of the state node
-  std::vector<SymbolIdent> get_state_successors(const StateIdent& node)
+  const std::vector<SymbolIdent>& get_state_successors(const StateIdent& node) const
   {
     return m_state_levels[node.level][node.id].successors;
   }
 
   //! Returns the successors of the symbol node
-  std::vector<StateIdent> get_symbol_successors(const SymbolIdent& node)
+  const std::vector<StateIdent>& get_symbol_successors(const SymbolIdent& node) const
   {
     return m_symbol_nodes[node.id].successors;
   }
@@ -237,36 +486,40 @@ public:
   }
 
   //! Adds a new semantic value to the specified symbol node
-  void add_semantics_to_symbol(const SymbolIdent& symbol, const std::string& value)
+  /** Returns true if the value was stored, false if it was present already
+   *  or the ambiguity policy rejected it.
+   */
+  bool add_semantics_to_symbol(const SymbolIdent& symbol, ValueIdent value, int rule = -1)
   {
-    m_symbol_nodes[symbol.id].add_value(value);
+    SymbolNode& node = m_symbol_nodes[symbol.id];
+    if(symbol_has_semantics(symbol, value))
+      return false;
+
+    if(m_prefer_rule && rule < node.rule)
+    {
+      // the value of a preferred rule replaces the current one
+      node.semantic_value = value;
+      node.other_values.clear();
+      node.rule = rule;
+    }
+    else if(m_max_values != 0 && node.other_values.size() + 1 >= m_max_values)
+      return false;
+    else
+      node.other_values.push_back(value);
+
+    node.ambiguity = no_markup;
+    return true;
   }
   //! Checks if the given symbol contains the given semantics
-  bool symbol_has_semantics(const SymbolIdent& symbol, const std::string& value)
+  bool symbol_has_semantics(const SymbolIdent& symbol, ValueIdent value) const
   {
-    return m_symbol_nodes[symbol.id].has_semantics(value);
-  }
-
-  //! Returns the XML string describing the set of semantic values stored in the specified symbol node
-  std::string get_semantic_string(const SymbolIdent& symbol)
-  {
-    std::string retval;
-    std::set<std::string>::iterator s_i;
-    
-    if (m_symbol_nodes[symbol.id].semantic_value.size() == 0)
-      return "";
-    else if (m_symbol_nodes[symbol.id].semantic_value.size() == 1)
-      return *(m_symbol_nodes[symbol.id].semantic_value.begin());
-     
-    retval = "<ambiguity>"; 
-    for(s_i = m_symbol_nodes[symbol.id].semantic_value.begin();
-        s_i != m_symbol_nodes[symbol.id].semantic_value.end();
-        s_i++)
-      retval += "<way>" + *s_i + "</way>";
-    
-    retval += "</ambiguity>";
-    
-    return retval;
+    const SymbolNode& node = m_symbol_nodes[symbol.id];
+    if(values_equal(node.semantic_value, value))
+      return true;
+    for(unsigned k = 0; k < node.other_values.size(); k++)
+      if(values_equal(node.other_values[k], value))
+        return true;
+    return false;
   }
 
 };
@@ -0,0 +1,194 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "BnfParser2.h"
+#include "Debug.h"
+#include "AnyBnfLoad.h"
+#include "LalrTable.h"
+#include "Tokenizer.h"
+#include "Prefilter.h"
+#include "GrammarCache.h"
+
+//! Identifies the format of the entries, increment when the format changes
+static const char cache_magic[] = "bnfparser2-cache 5";
+
+void GrammarCache::Digest::update(const char *data, size_t length)
+{
+  for(size_t i = 0; i < length; i++)
+  {
+    m_value ^= static_cast<unsigned char>(data[i]);
+    m_value *= 1099511628211ULL;
+  }
+}
+
+void GrammarCache::Digest::update(const std::string& data)
+{
+  std::ostringstream length;
+  // the length prevents ambiguity of concatenated strings
+  length << data.size() << ':';
+  update(length.str().data(), length.str().size());
+  update(data.data(), data.size());
+}
+
+std::string GrammarCache::Digest::hex(void) const
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string result(16, '0');
+  unsigned long long value = m_value;
+
+  for(int i = 15; i >= 0; i--)
+  {
+    result[i] = digits[value & 0xF];
+    value >>= 4;
+  }
+  return result;
+}
+
+std::string GrammarCache::digest_file(const std::string& file_name)
+{
+  std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+  if(!file)
+    return "";
+
+  Digest digest;
+  char buffer[4096];
+  while(file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+    digest.update(buffer, file.gcount());
+
+  return digest.hex();
+}
+
+bool GrammarCache::read_entry(const std::string& key, AnyBnfLoad& grammar, Tokenizer& tokenizer,
+  Prefilter& prefilter, LalrTable*& table)
+{
+  std::ifstream entry(get_entry_name(key).c_str(), std::ios::in | std::ios::binary);
+  if(!entry)
+  {
+    logTrace(LOG_INFO, "  cache miss: " << key);
+    return false;
+  }
+
+  std::string line;
+  if(!std::getline(entry, line) || line != cache_magic)
+  {
+    logTrace(LOG_INFO, "  cache entry " << key << " has unknown format");
+    return false;
+  }
+
+  // all the files used to build the table must be unchanged
+  size_t file_count;
+  std::string digest, file_name;
+  if(!(entry >> file_count))
+    return false;
+  for(size_t i = 0; i < file_count; i++)
+  {
+    if(!(entry >> digest) || entry.get() != ' ' || !std::getline(entry, file_name))
+      return false;
+    if(digest_file(file_name) != digest)
+    {
+      logTrace(LOG_INFO, "  cache entry " << key << " is stale, " << file_name << " changed");
+      return false;
+    }
+  }
+
+  unsigned nonterm_count;
+  if(!grammar.read_names(entry) || !(entry >> nonterm_count) || !tokenizer.read(entry)
+    || !prefilter.read(entry))
+  {
+    logTrace(LOG_INFO, "  cache entry " << key << " is corrupted");
+    return false;
+  }
+
+  LalrTable *new_table = new LalrTable(nonterm_count, tokenizer.get_token_count());
+  if(!new_table->read_table(entry))
+  {
+    logTrace(LOG_INFO, "  cache entry " << key << " is corrupted");
+    delete new_table;
+    return false;
+  }
+
+  logTrace(LOG_INFO, "  cache hit: " << key);
+  delete table;
+  table = new_table;
+  return true;
+}
+
+void GrammarCache::write_entry(const std::string& key, const AnyBnfLoad& grammar,
+  const Tokenizer& tokenizer, const Prefilter& prefilter, LalrTable& table, unsigned nonterm_count)
+{
+  const std::vector<std::string>& files = grammar.get_loaded_files();
+
+#ifndef _WIN32
+  // create the directory if it does not exist yet
+  mkdir(m_directory.c_str(), 0777);
+#endif
+
+  // the entry is written to a temporary file and then renamed, so that the
+  // processes sharing the directory never see an incomplete entry
+  std::ostringstream temp_name;
+  temp_name << get_entry_name(key) << ".tmp";
+#ifndef _WIN32
+  temp_name << getpid();
+#endif
+
+  std::ofstream entry(temp_name.str().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if(!entry)
+  {
+    BnfReport report(m_interface->get_reporter(), BnfReporter::ErrorType_Warning);
+    report.text()
+      << "Cannot create cache entry " << temp_name.str() << ".";
+    return;
+  }
+
+  entry << cache_magic << '\n';
+  entry << files.size() << '\n';
+  for(std::vector<std::string>::const_iterator pos = files.begin();
+    pos != files.end(); pos++)
+  {
+    entry << digest_file(*pos) << ' ' << *pos << '\n';
+  }
+  grammar.write_names(entry);
+  entry << nonterm_count << '\n';
+  tokenizer.write(entry);
+  prefilter.write(entry);
+  table.write_table(entry);
+  entry.close();
+
+  if(!entry || rename(temp_name.str().c_str(), get_entry_name(key).c_str()) != 0)
+  {
+    remove(temp_name.str().c_str());
+
+    BnfReport report(m_interface->get_reporter(), BnfReporter::ErrorType_Warning);
+    report.text()
+      << "Cannot write cache entry " << get_entry_name(key) << ".";
+    return;
+  }
+
+  logTrace(LOG_INFO, "  cache entry " << key << " written");
+}
+
+// end of file
@@ -0,0 +1,110 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#ifndef _GRAMMARCACHE_
+#define _GRAMMARCACHE_
+
+#include <string>
+#include <vector>
+
+class BnfParser2;
+class AnyBnfLoad;
+class LalrTable;
+class Tokenizer;
+class Prefilter;
+
+/** \brief On-disk cache of compiled grammars.
+ *
+ *  Each entry holds the GLALR table, the token automata, the prefilter and
+ *  the nonterminal names of one grammar set. The entries are content-addressed: the key is a
+ *  digest of the library version, the start symbol, the search paths and the
+ *  exact bytes of every grammar passed to add_grammar(). The entry also lists all the files read
+ *  while the table was built (referenced grammars, syntax configurations)
+ *  together with their digests and it is used only if none of them changed.
+ */
+class GrammarCache
+{
+public:
+  //! Incremental 64-bit FNV-1a digest
+  class Digest
+  {
+    unsigned long long m_value;
+  public:
+    Digest(void)
+    : m_value(14695981039346656037ULL)
+    {}
+
+    //! Adds the given bytes to the digest
+    void update(const char *data, size_t length);
+
+    //! Adds the given string to the digest, including its length
+    void update(const std::string& data);
+
+    //! Returns the digest as a string of 16 hexadecimal digits
+    std::string hex(void) const;
+  };
+
+  //! Returns the digest of the file contents, empty string if the file cannot be read
+  static std::string digest_file(const std::string& file_name);
+
+  GrammarCache(BnfParser2 *interface)
+  : m_interface(interface)
+  {}
+
+  //! Sets the directory the entries are stored in, caching is disabled when empty
+  void set_directory(const std::string& directory)
+  {
+    m_directory = directory;
+  }
+
+  //! Returns true if the cache directory was set
+  bool enabled(void) const
+  {
+    return !m_directory.empty();
+  }
+
+  //! Looks up the entry with the given key
+  /** On success fills the nonterminal names of the grammar, the tokens and
+   *  the prefilter, creates the table and returns true. The files listed in
+   *  the entry must not be changed.
+   */
+  bool read_entry(const std::string& key, AnyBnfLoad& grammar, Tokenizer& tokenizer,
+    Prefilter& prefilter, LalrTable*& table);
+
+  //! Stores the entry with the given key
+  /** Failures are reported as warnings only, the parser works without the cache.
+   */
+  void write_entry(const std::string& key, const AnyBnfLoad& grammar,
+    const Tokenizer& tokenizer, const Prefilter& prefilter, LalrTable& table, unsigned nonterm_count);
+
+private:
+  BnfParser2 *m_interface;
+
+  //! The directory the entries are stored in
+  std::string m_directory;
+
+  //! Returns the name of the file storing the entry with the given key
+  std::string get_entry_name(const std::string& key) const
+  {
+    return m_directory + "/" + key + ".bnft";
+  }
+};
+
+#endif  //_GRAMMARCACHE_
+
+// end of file
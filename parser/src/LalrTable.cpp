@@ -155,8 +155,11 @@ void LalrTable::compute_ext_nont_first(void)
   std::set<int> help_set;
   
   help_set.insert(epsilon);
+  //only the nullable nonterminals are looked up by build_table(), the
+  //members with different first parts do not affect each other
   for(j = 0; j < m_nonterm_count; j++)
-    m_ext_nont_firsts[j].insert(std::make_pair(j, help_set));
+    if(m_firsts[j].find(epsilon) != m_firsts[j].end())
+      m_ext_nont_firsts[j].insert(std::make_pair(j, help_set));
     
   while(change)
   {
@@ -323,7 +326,6 @@ void LalrTable::compute_neps_first(void)
 
 void LalrTable::compute_lr0_items(void)
 {
-  std::map<int, std::set<std::pair<int, int> > > members;
   std::map<int, std::set<std::pair<int, int> > >::iterator members_iter;
   unsigned state_count = 1, current_state = 0;
   std::set<std::pair<int, int> >::iterator l;
@@ -336,6 +338,7 @@ void LalrTable::compute_lr0_items(void)
 
 
   std::map<std::set<std::pair<int, int> >, unsigned>::iterator items_map_iter;
+  std::map<std::set<std::pair<int, int> >, goto_memo>::iterator memo_iter;
   
   //Here the initial rule is added
   std::set<std::pair<int, int> > help_set;
@@ -343,50 +346,57 @@ void LalrTable::compute_lr0_items(void)
   m_items.push_back(help_set);
   m_items_map.insert(std::make_pair(help_set, 0));
   
-  m_go_to.push_back(std::vector<int>(m_nonterm_count + 256, -1)); //-1 is the default value
+  m_go_to.push_back(std::vector<int>(m_nonterm_count + get_column_count() - 1, -1)); //-1 is the default value
   
   while(current_state != state_count)
   {
     logTrace(LOG_DEBUG, "current_state: "<< current_state);
     logTrace(LOG_DEBUG, "state_count:   "<< state_count);
   
-    members.clear();
-    for(l = m_items[current_state].begin(); l != m_items[current_state].end(); l++)
-    //for each item from the kernel
+    //the transitions of the kernel may be known from the previous build
+    memo_iter = m_gotos.find(m_items[current_state]);
+    if(memo_iter == m_gotos.end())
     {
-      //the dot cannot be on the right end of the rule
-      if(static_cast<int>(((m_rules[(*l).first]).second).size()) > (*l).second)
-      //If the item looks like A -> B.CD, item A -> BC.D is added to members[C]
-      members[((m_rules[(*l).first]).second)[(*l).second]].insert(std::make_pair((*l).first, (*l).second + 1));
-
-      //for all the nonterms Q such that A -> x.Cy is in the current state and C ->* Q
-      //dot cannot be in the last position
-      if(static_cast<int>(((m_rules[(*l).first]).second).size()) > (*l).second)
-        if(((m_rules[(*l).first]).second).is_nonterminal((*l).second))//if the dot is before a nonterm
-          for(k = m_nont_firsts[((m_rules[(*l).first]).second)[(*l).second]].begin();
-            k != m_nont_firsts[((m_rules[(*l).first]).second)[(*l).second]].end();
-            k++)
-          {
+      memo_iter = m_gotos.insert(std::make_pair(m_items[current_state], goto_memo())).first;
+      std::map<int, std::set<std::pair<int, int> > >& members = memo_iter->second.members;
 
-          range_iter = m_rules_map.equal_range(*k);
-          for(cycle_iter = range_iter.first; cycle_iter != range_iter.second; cycle_iter++)
-            if(cycle_iter->second.size() > 1)  // last position of the rule is the number of the rule
-              members[cycle_iter->second.at(0)].insert(std::make_pair(
-                                           cycle_iter->second.at(cycle_iter->second.size() - 1), 1));
+      for(l = m_items[current_state].begin(); l != m_items[current_state].end(); l++)
+      //for each item from the kernel
+      {
+        //the dot cannot be on the right end of the rule
+        if(static_cast<int>(((m_rules[(*l).first]).second).size()) > (*l).second)
+        //If the item looks like A -> B.CD, item A -> BC.D is added to members[C]
+        members[((m_rules[(*l).first]).second)[(*l).second]].insert(std::make_pair((*l).first, (*l).second + 1));
 
+        //for all the nonterms Q such that A -> x.Cy is in the current state and C ->* Q
+        //dot cannot be in the last position
+        if(static_cast<int>(((m_rules[(*l).first]).second).size()) > (*l).second)
+          if(((m_rules[(*l).first]).second).is_nonterminal((*l).second))//if the dot is before a nonterm
+          {
+            memo_iter->second.depends_on.insert(((m_rules[(*l).first]).second)[(*l).second]);
+            for(k = m_nont_firsts[((m_rules[(*l).first]).second)[(*l).second]].begin();
+              k != m_nont_firsts[((m_rules[(*l).first]).second)[(*l).second]].end();
+              k++)
+            {
+              memo_iter->second.depends_on.insert(*k);
 
-        }
+              range_iter = m_rules_map.equal_range(*k);
+              for(cycle_iter = range_iter.first; cycle_iter != range_iter.second; cycle_iter++)
+                if(cycle_iter->second.size() > 1)  // last position of the rule is the number of the rule
+                  members[cycle_iter->second.at(0)].insert(std::make_pair(
+                                               cycle_iter->second.at(cycle_iter->second.size() - 1), 1));
+            }
+          }
       }
+    }
+    std::map<int, std::set<std::pair<int, int> > >& members = memo_iter->second.members;
 
       for(members_iter = members.begin(); members_iter != members.end(); members_iter++)
       {
         items_map_iter = m_items_map.find(members_iter->second);
         if(items_map_iter != m_items_map.end())
         {
-          if(members_iter->first <= 0) //is terminal
-            m_go_to[current_state][- members_iter->first] = items_map_iter->second; //0-255 - terminals
-          else
-            m_go_to[current_state][members_iter->first + 256] = items_map_iter->second; //255+ - nonterminals
+          m_go_to[current_state][get_symbol_index(members_iter->first)] = items_map_iter->second;
 
           logTrace(LOG_DEBUG, "goto1(" << current_state<<", " << members_iter->first << ") = "
             << items_map_iter->second);
@@ -395,16 +405,13 @@ void LalrTable::compute_lr0_items(void)
         {
           logTrace(LOG_DEBUG, "goto2(" << current_state<<", " << members_iter->first << ") = " << state_count);
       
-          if(members_iter->first <= 0)
-            m_go_to[current_state][- members_iter->first] = state_count; //0-255 - terminals
-          else
-            m_go_to[current_state][members_iter->first + 256] = state_count; //255+ - nonterminals
+          m_go_to[current_state][get_symbol_index(members_iter->first)] = state_count;
 
           m_items.push_back(members_iter->second);
           m_items_map.insert(std::make_pair(members_iter->second, state_count));
 
           state_count++;
-          m_go_to.push_back(std::vector<int>(m_nonterm_count + 256, -1)); //-1 as the default value
+          m_go_to.push_back(std::vector<int>(m_nonterm_count + get_column_count() - 1, -1)); //-1 as the default value
         }
       }
   
@@ -412,14 +419,11 @@ void LalrTable::compute_lr0_items(void)
   } 
 }
 
-void LalrTable::compute_lookaheads()
+const LalrTable::closure_memo& LalrTable::get_closure(int rulenumber, int dotpos)
 {
-  int rulenumber, dotpos;
   int dotsymbol;
   unsigned rule_from_map;
-  bool found;
   bool change;
-  std::map<std::pair<int, int>, std::set<int> > closure;
   std::map<std::pair<int, int>, std::set<int> >::iterator processed_item;
   std::map<std::pair<int, int>, std::set<int> >::iterator closure_iter;
   std::set<int> first_beta_a;
@@ -432,26 +436,18 @@ void LalrTable::compute_lookaheads()
   typedef std::multimap<int, marked_vector>::iterator MIT;
   std::pair<MIT, MIT> range_iter;
   MIT cycle_iter;
-  
-////////////////////////
-  for(unsigned state = 0; state < m_ext_items.size(); state++)
-  {
-   for(unsigned var2 = 0; var2 < m_ext_items[state].size(); var2++)
-   {
-    //For each item in each state
-    
-    rulenumber = m_ext_items[state][var2].rule_number;
-    dotpos = m_ext_items[state][var2].dot_position;
-  
+
+  std::map<std::pair<int, int>, closure_memo>::iterator memo_iter =
+    m_closures.find(std::make_pair(rulenumber, dotpos));
+  if(memo_iter != m_closures.end())
+    return memo_iter->second;
+
+  memo_iter = m_closures.insert(std::make_pair(std::make_pair(rulenumber, dotpos), closure_memo())).first;
+  std::map<std::pair<int, int>, std::set<int> >& closure = memo_iter->second.closure;
+  std::set<int>& depends_on = memo_iter->second.depends_on;
+
 //////Here the LR(1) closure is computed
-    while(!(process_stack.empty()))
-      process_stack.pop();
-  
     //initialisation
-    closure.clear();
-    to_be_processed.clear();
-
-    first_beta_a.clear();
     first_beta_a.insert(cross_char);
     processed_item = closure.insert(std::make_pair(std::make_pair(rulenumber, dotpos), first_beta_a)).first;
     to_be_processed.insert(std::make_pair(rulenumber, dotpos));
@@ -489,6 +485,7 @@ void LalrTable::compute_lookaheads()
           break;
         }
         
+        depends_on.insert(((m_rules[processed_item->first.first]).second)[x]);
         for(std::set<int>::iterator
               is = m_firsts[((m_rules[processed_item->first.first]).second)[x]].begin();
               is != m_firsts[((m_rules[processed_item->first.first]).second)[x]].end();
@@ -515,11 +512,11 @@ void LalrTable::compute_lookaheads()
         dotsymbol = ((m_rules[processed_item->first.first]).second)
                                                 [processed_item->first.second];
 
+        depends_on.insert(dotsymbol);
         range_iter = m_rules_map.equal_range(dotsymbol);
         for(cycle_iter = range_iter.first; cycle_iter != range_iter.second; cycle_iter++)
        //looking for all the rules with the nonterm in front of the dot on the left side
         {
-          found = false;
           rule_from_map = cycle_iter->second.at(cycle_iter->second.size() - 1);
           closure_iter = closure.find(std::make_pair(rule_from_map, 0));
 
@@ -552,7 +549,28 @@ void LalrTable::compute_lookaheads()
         }
       }
     }//while cycle
+
+  return memo_iter->second;
+}
+
+void LalrTable::compute_lookaheads()
+{
+  int rulenumber, dotpos;
+  bool change;
+  std::map<std::pair<int, int>, std::set<int> >::const_iterator closure_iter;
+
+////////////////////////
+  for(unsigned state = 0; state < m_ext_items.size(); state++)
+  {
+   for(unsigned var2 = 0; var2 < m_ext_items[state].size(); var2++)
+   {
+    //For each item in each state
+    
+    rulenumber = m_ext_items[state][var2].rule_number;
+    dotpos = m_ext_items[state][var2].dot_position;
   
+    const std::map<std::pair<int, int>, std::set<int> >& closure = get_closure(rulenumber, dotpos).closure;
+
   ////LR(1) closure for one kernel item now computed
 
   ////Here the spontaneous lookaheads/propagation of the lookaheads is computed
@@ -569,7 +587,7 @@ void LalrTable::compute_lookaheads()
       gotoitem_second = closure_iter->first.second + 1;
       symbol = (m_rules[closure_iter->first.first].second)[gotoitem_second - 1];
       
-      goto_index1 = m_go_to[state][(symbol <= 0)?-symbol:symbol + 256];  //terminal or nonterminal?
+      goto_index1 = m_go_to[state][get_symbol_index(symbol)];
   
       for(unsigned y = 0; y < m_ext_items[goto_index1].size(); y++)
         if(m_ext_items[goto_index1][y].rule_number == gotoitem_first &&
@@ -665,8 +683,8 @@ void LalrTable::build_table(void)
 
   for(i = 0; i < m_ext_items.size(); i++)
   {
-    //256 chars + end_of_input
-    m_table[i].resize(1 + 256);
+    //256 chars + end_of_input + tokens
+    m_table[i].resize(get_column_count());
     
     //for each item in the state
     for(j = 0; j < m_ext_items[i].size(); j++)
@@ -680,7 +698,7 @@ void LalrTable::build_table(void)
           help_action.what = action::shift;
           help_action.next_state = m_go_to[i][- dot_symbol];
           help_action.reduce_by = -1;
-          help_action.reduce_by = -1;
+          help_action.reduce_length = 0;
           m_table[i][- dot_symbol].insert(help_action);
 
           logTrace(LOG_DEBUG, "State " << i << ", symbol "
@@ -694,7 +712,7 @@ void LalrTable::build_table(void)
           {
             help_action.next_state = m_go_to[i][- (*k)];
             help_action.reduce_by = -1;
-            help_action.reduce_by = -1;
+            help_action.reduce_length = 0;
             m_table[i][-(*k)].insert(help_action);
 
             logTrace(LOG_DEBUG, "State " << i << ", symbol "
@@ -814,6 +832,15 @@ void LalrTable::build_table(void)
   }
 }
 
+void LalrTable::find_token_columns(void)
+{
+  m_token_columns.assign(m_table.size(), std::vector<int>());
+  for(unsigned i = 0; i < m_table.size(); i++)
+    for(unsigned j = 1 + 256; j < get_column_count(); j++)
+      if(!m_table[i][j].empty())
+        m_token_columns[i].push_back(j);
+}
+
 bool operator<(const LalrTable::action& a1, const LalrTable::action& a2)
 {
   if(a1.what < a2.what)
@@ -835,7 +862,14 @@ void LalrTable::make_lalr_table(void)
 
   logTrace(LOG_INFO, "  computing first");
   compute_first();
-  
+
+  make_automaton();
+
+  logTrace(LOG_INFO, "## LALR table computing end ##");
+}
+
+void LalrTable::make_automaton(void)
+{
   logTrace(LOG_INFO, "  computing nont_first");
   compute_nont_first();
   
@@ -902,8 +936,124 @@ void LalrTable::make_lalr_table(void)
 
   logTrace(LOG_INFO, "  building GLALR table");
   build_table();
+  find_token_columns();
+}
 
-  logTrace(LOG_INFO, "## LALR table computing end ##");
+void LalrTable::forget_closures(const std::set<int>& changed)
+{
+  std::set<int>::const_iterator pos;
+
+  for(std::map<std::pair<int, int>, closure_memo>::iterator
+    closure_iter = m_closures.begin(); closure_iter != m_closures.end();)
+  {
+    for(pos = changed.begin(); pos != changed.end(); pos++)
+      if(closure_iter->second.depends_on.find(*pos) != closure_iter->second.depends_on.end())
+        break;
+
+    if(pos != changed.end())
+      m_closures.erase(closure_iter++);
+    else
+      closure_iter++;
+  }
+
+  for(std::map<std::set<std::pair<int, int> >, goto_memo>::iterator
+    goto_iter = m_gotos.begin(); goto_iter != m_gotos.end();)
+  {
+    for(pos = changed.begin(); pos != changed.end(); pos++)
+      if(goto_iter->second.depends_on.find(*pos) != goto_iter->second.depends_on.end())
+        break;
+
+    if(pos != changed.end())
+      m_gotos.erase(goto_iter++);
+    else
+      goto_iter++;
+  }
+}
+
+bool LalrTable::update(const std::multimap<int, std::vector<int> >& input, unsigned nonterm_count,
+  unsigned token_count)
+{
+  std::map<std::pair<int, std::vector<int> >, unsigned> known_rules;
+  std::map<std::pair<int, std::vector<int> >, unsigned>::iterator known;
+  std::vector<std::pair<int, std::vector<int> > > new_rules;
+  std::multimap<int, std::vector<int> >::const_iterator i;
+  std::set<int> changed;
+  std::vector<int> rhs;
+
+  // the symbols keep their numbers, the new tokens are appended (see
+  // Tokenizer::compile()) and only move the columns of the nonterminals
+  if(nonterm_count < m_nonterm_count || token_count < m_token_count)
+    return false;
+
+  // count the rules the table was built from
+  for(unsigned r = 0; r < m_rules.size(); r++)
+    known_rules[std::make_pair(m_rules[r].first, m_rules[r].second.data())]++;
+
+  for(i = input.begin(); i != input.end(); i++)
+  {
+    known = known_rules.find(*i);
+    if(known != known_rules.end() && known->second > 0)
+      known->second--;
+    else
+      new_rules.push_back(*i);
+  }
+
+  // all the known rules must be still present
+  for(known = known_rules.begin(); known != known_rules.end(); known++)
+    if(known->second > 0)
+      return false;
+
+  logTrace(LOG_INFO, "## LALR table update start, " << new_rules.size() << " new rules ##");
+
+  // the new rules are appended, so the memorized items remain valid
+  for(unsigned r = 0; r < new_rules.size(); r++)
+  {
+    m_rules.push_back(std::make_pair(new_rules[r].first, marked_vector(new_rules[r].second)));
+    changed.insert(new_rules[r].first);
+  }
+
+  m_rules_map.clear();
+  for(unsigned r = 0; r < m_rules.size(); r++)
+  {
+    rhs = m_rules[r].second.data();
+    rhs.push_back(r);
+    m_rules_map.insert(std::make_pair(m_rules[r].first, rhs));
+  }
+
+  std::vector<std::set<int> > old_firsts;
+  old_firsts.swap(m_firsts);
+
+  m_nonterm_count = nonterm_count;
+  m_token_count = token_count;
+  m_firsts.assign(m_nonterm_count, std::set<int>());
+  m_nont_firsts.assign(m_nonterm_count, std::set<int>());
+  m_neps_firsts.assign(m_nonterm_count, std::set<int>());
+  m_ext_nont_firsts.assign(m_nonterm_count, std::map<int, std::set<int> >());
+  m_items.clear();
+  m_items_map.clear();
+  m_go_to.clear();
+  m_ext_items.clear();
+  m_table.clear();
+
+  logTrace(LOG_INFO, "  computing first");
+  compute_first();
+
+  // the closures depend on the first sets of the symbols behind the dot
+  for(unsigned n = 0; n < m_nonterm_count; n++)
+    if(n >= old_firsts.size() || m_firsts[n] != old_firsts[n])
+      changed.insert(n);
+
+  size_t closure_count = m_closures.size();
+  size_t goto_count = m_gotos.size();
+  forget_closures(changed);
+  logTrace(LOG_INFO, "  " << changed.size() << " nonterminals changed, reusing "
+    << m_closures.size() << " of " << closure_count << " closures and "
+    << m_gotos.size() << " of " << goto_count << " transitions");
+
+  make_automaton();
+
+  logTrace(LOG_INFO, "## LALR table update end ##");
+  return true;
 }
 
 void LalrTable::load(const std::multimap<int, std::vector<int> >& input)
@@ -930,7 +1080,7 @@ void LalrTable::print_table(const std::string& file_name)
   unsigned i, j;
   
   for(i = 0; i < m_table.size(); i++)
-    for(j = 1; j <= 256; j++)
+    for(j = 1; j < get_column_count(); j++)
       if(!m_table[i][j].empty())
         used_terminals.insert(j);
         
@@ -948,6 +1098,8 @@ void LalrTable::print_table(const std::string& file_name)
     {
       if(-(*set_iter) == end_of_input)
         out_file << "$: |";
+      else if(-(*set_iter) < end_of_input)
+        out_file << "token " << *set_iter - 257 << ": |";
       else
         out_file << static_cast<char>(*set_iter) << ": |";
           
@@ -971,14 +1123,191 @@ void LalrTable::print_table(const std::string& file_name)
   for(i = 0; i < m_table.size(); i++)
   {
     out_file << "#### state " << i << " ####" << std::endl;
-    for(j = 256; j < 256 + m_nonterm_count; j++)
-      out_file << j - 256 << ": " << m_go_to[i][j] << std::endl;
+    for(j = 0; j < m_nonterm_count; j++)
+      out_file << j << ": " << m_go_to[i][get_symbol_index(j)] << std::endl;
   }
     
   
 }
 
+void LalrTable::write_table(std::ostream& out)
+{
+  unsigned i, j, k;
+  std::set<action>::const_iterator action_iter;
+  size_t cells;
+
+  out << m_token_count << '\n';
+  out << m_rules.size() << '\n';
+  for(i = 0; i < m_rules.size(); i++)
+  {
+    out << m_rules[i].first << ' ' << m_rules[i].second.size();
+    for(j = 0; j < m_rules[i].second.size(); j++)
+      out << ' ' << m_rules[i].second.data()[j];
+    out << '\n';
+  }
+
+  out << m_table.size() << ' ' << m_accepting_state << '\n';
+  for(i = 0; i < m_table.size(); i++)
+  {
+    //only the cells with some actions are stored
+    cells = 0;
+    for(j = 0; j < m_table[i].size(); j++)
+      if(!m_table[i][j].empty())
+        cells++;
+    out << cells;
+    for(j = 0; j < m_table[i].size(); j++)
+    {
+      if(m_table[i][j].empty())
+        continue;
+      out << ' ' << j << ' ' << m_table[i][j].size();
+      for(action_iter = m_table[i][j].begin(); action_iter != m_table[i][j].end(); action_iter++)
+        out << ' ' << action_iter->what << ' ' << action_iter->next_state
+          << ' ' << action_iter->reduce_by << ' ' << action_iter->reduce_length;
+    }
+    out << '\n';
+
+    //the go_to entries are mostly -1 (no transition)
+    cells = 0;
+    for(k = 0; k < m_go_to[i].size(); k++)
+      if(m_go_to[i][k] != -1)
+        cells++;
+    out << cells;
+    for(k = 0; k < m_go_to[i].size(); k++)
+      if(m_go_to[i][k] != -1)
+        out << ' ' << k << ' ' << m_go_to[i][k];
+    out << '\n';
+  }
+}
+
+bool LalrTable::read_table(std::istream& in)
+{
+  size_t rule_count, state_count, length, cells, actions;
+  unsigned i, j, k, column;
+  int lhs, value, what;
+  std::vector<int> rhs;
+  action help_action;
+
+  if(!(in >> m_token_count >> rule_count))
+    return false;
+  for(i = 0; i < rule_count; i++)
+  {
+    if(!(in >> lhs >> length))
+      return false;
+    rhs.clear();
+    for(j = 0; j < length; j++)
+    {
+      if(!(in >> value))
+        return false;
+      rhs.push_back(value);
+    }
+    m_rules.push_back(std::make_pair(lhs, marked_vector(rhs)));
+  }
+
+  if(!(in >> state_count >> m_accepting_state))
+    return false;
+  m_table.resize(state_count);
+  m_go_to.resize(state_count);
+  for(i = 0; i < state_count; i++)
+  {
+    //256 chars + end_of_input + tokens
+    m_table[i].resize(get_column_count());
+    if(!(in >> cells))
+      return false;
+    for(j = 0; j < cells; j++)
+    {
+      if(!(in >> column >> actions) || column >= m_table[i].size())
+        return false;
+      for(k = 0; k < actions; k++)
+      {
+        if(!(in >> what >> help_action.next_state >> help_action.reduce_by >> help_action.reduce_length))
+          return false;
+        help_action.what = (what == action::shift) ? action::shift : action::reduce;
+        m_table[i][column].insert(help_action);
+      }
+    }
+
+    m_go_to[i].assign(m_nonterm_count + get_column_count() - 1, -1);
+    if(!(in >> cells))
+      return false;
+    for(j = 0; j < cells; j++)
+    {
+      if(!(in >> column >> value) || column >= m_go_to[i].size())
+        return false;
+      m_go_to[i][column] = value;
+    }
+  }
+
+  find_token_columns();
+  return true;
+}
+
 #ifdef LALRTABLE_TEST
+//! Returns the rule as a vector, the left side first
+static std::vector<int> rule_of(LalrTable& table, int rule)
+{
+  std::vector<int> result(1, table.get_lhs(rule));
+  for(unsigned i = 0; i < table.get_rule_length(rule); i++)
+    result.push_back(table.symbol_is_marked(rule, i) ? INT_MAX - table.get_symbol(rule, i)
+      : table.get_symbol(rule, i));
+  return result;
+}
+
+//! Checks the two tables describe the same automaton, the numbering of the rules
+//! and the states may differ
+static bool same_automaton(LalrTable& first, LalrTable& second, unsigned nonterm_count)
+{
+  std::map<int, int> state_map;
+  std::list<std::pair<int, int> > pending;
+  std::set<LalrTable::action>::const_iterator pos;
+
+  state_map[0] = 0;
+  pending.push_back(std::make_pair(0, 0));
+  while(!pending.empty())
+  {
+    int s1 = pending.front().first, s2 = pending.front().second;
+    pending.pop_front();
+
+    if((s1 == static_cast<int>(first.get_accepting_state())) !=
+       (s2 == static_cast<int>(second.get_accepting_state())))
+      return false;
+
+    for(unsigned symbol = 1; symbol < 256 + nonterm_count; symbol++)
+    {
+      int t1 = first.get_go_to(s1, symbol), t2 = second.get_go_to(s2, symbol);
+      if((t1 == -1) != (t2 == -1))
+        return false;
+      if(t1 == -1)
+        continue;
+
+      if(state_map.find(t1) == state_map.end())
+      {
+        state_map[t1] = t2;
+        pending.push_back(std::make_pair(t1, t2));
+      }
+      else if(state_map[t1] != t2)
+        return false;
+    }
+
+    for(int lookahead = 1; lookahead <= -LalrTable::end_of_input; lookahead++)
+    {
+      std::set<std::pair<int, std::vector<int> > > actions1, actions2;
+      for(pos = first.get_actions(s1, lookahead).begin(); pos != first.get_actions(s1, lookahead).end(); pos++)
+        if(pos->what == LalrTable::action::reduce)
+          actions1.insert(std::make_pair(pos->reduce_length, rule_of(first, pos->reduce_by)));
+        else
+          actions1.insert(std::make_pair(-1, std::vector<int>(1, state_map[pos->next_state])));
+      for(pos = second.get_actions(s2, lookahead).begin(); pos != second.get_actions(s2, lookahead).end(); pos++)
+        if(pos->what == LalrTable::action::reduce)
+          actions2.insert(std::make_pair(pos->reduce_length, rule_of(second, pos->reduce_by)));
+        else
+          actions2.insert(std::make_pair(-1, std::vector<int>(1, pos->next_state)));
+      if(actions1 != actions2)
+        return false;
+    }
+  }
+  return true;
+}
+
 int main(void)
 {
   const unsigned nonterm_count = 4;
@@ -1072,6 +1401,47 @@ int main(void)
   table.load(grammar);
   table.make_lalr_table();
   table.print_table("table.txt");
+
+  /*
+  incremental rebuild, new nonterminal I added:
+  L -> I
+  I -> id
+  */
+  const unsigned new_nonterm_count = 5;
+  std::multimap<int, std::vector<int> > new_grammar(grammar);
+
+  line.push_back(4);
+  new_grammar.insert(std::pair<int, std::vector<int> >(2, line));
+  line.clear();
+
+  line.push_back(-105);
+  line.push_back(-100);
+  new_grammar.insert(std::pair<int, std::vector<int> >(4, line));
+  line.clear();
+
+  if(!table.update(new_grammar, new_nonterm_count))
+  {
+    std::cerr << "incremental rebuild refused" << std::endl;
+    return 1;
+  }
+
+  LalrTable clean_table(new_nonterm_count);
+  clean_table.load(new_grammar);
+  clean_table.make_lalr_table();
+
+  if(!same_automaton(table, clean_table, new_nonterm_count))
+  {
+    std::cerr << "incremental rebuild differs from the clean build" << std::endl;
+    return 1;
+  }
+
+  // the rules cannot be removed
+  if(table.update(grammar, new_nonterm_count))
+  {
+    std::cerr << "incremental rebuild accepted removed rules" << std::endl;
+    return 1;
+  }
+
   return 0;
 }
 #endif
@@ -130,6 +130,12 @@ private:
       return (m_data.at(index) > 0);
     }
   
+    //! returns the encapsulated vector (including marking)
+    const std::vector<int>& data(void) const
+    {
+      return m_data;
+    }
+
     //! constructor with one parameter - std::vector<int>
     marked_vector(std::vector<int> input)
     {
@@ -170,6 +176,9 @@ private:
   std::map<std::set<std::pair<int, int> >, unsigned> m_items_map;
   
   
+  //! The number of the token terminals, see get_symbol_index()
+  unsigned m_token_count;
+
   //! The structure used for storing go_to information for each state and grammar symbol
   /** m_go_to[s][g] contains the number of the state the DFA goes to after
    *  reading symbol g in state s. The way the indexing of the symbols is done is
@@ -177,6 +186,8 @@ private:
    *  have its entries on the indexes from 1 to 255, nonterminal symbols 
    *  (from 0 to #m_nonterm_count) have its entries on the indexes starting with 256.
    *  The index of the entry for a nonterminal x is computed as 256 + x.   
+   *  When the grammar contains token terminals (from -257 to -256-#m_token_count),
+   *  the nonterminals are moved by #m_token_count, see get_symbol_index().
    *  
    *  \warning The way the symbols are indexed is a bit confusing.   
    */  
@@ -208,7 +219,7 @@ private:
    *         with with the symbols that could appear after B. 
    *  
    *  If A ->* B<beta>, then m_ext_nont_firsts[A] contains the pair (B, S) and
-   *  first(<beta>) is a subset of S.
+   *  first(<beta>) is a subset of S. Only the nullable nonterminals B are stored.
    */    
   std::vector<std::map<int, std::set<int> > > m_ext_nont_firsts;
   
@@ -216,6 +227,38 @@ private:
   //! Holds the number of the accepting state
   unsigned m_accepting_state;
 
+  //! The LR(1) closure of one kernel item, kept to be reused
+  class closure_memo
+  {
+  public:
+    //! the closure items with their lookaheads, computed with the # lookahead
+    std::map<std::pair<int, int>, std::set<int> > closure;
+    //! the nonterminals whose rules or first sets the closure depends on
+    std::set<int> depends_on;
+  };
+
+  //! The transitions of one LR(0) kernel, kept to be reused
+  class goto_memo
+  {
+  public:
+    //! the kernels of the successor states for each grammar symbol
+    std::map<int, std::set<std::pair<int, int> > > members;
+    //! the nonterminals whose rules the transitions depend on
+    std::set<int> depends_on;
+  };
+
+  //! The token columns of the table with some actions, for each state
+  std::vector<std::vector<int> > m_token_columns;
+
+  //! Fills #m_token_columns. Must not be called before the table is complete!
+  void find_token_columns(void);
+
+  //! The closures of the kernel items computed so far, see update()
+  std::map<std::pair<int, int>, closure_memo> m_closures;
+
+  //! The transitions of the LR(0) kernels computed so far, see update()
+  std::map<std::set<std::pair<int, int> >, goto_memo> m_gotos;
+
   
   //! Prints the LR(0) item on cerr.
   void print_item(const std::pair<int, int>& item);
@@ -235,18 +278,32 @@ private:
   //! Fills the #m_items structure.  Must not be called before compute_nont_first()!
   void compute_lr0_items(void);
   
+  //! Returns the LR(1) closure of the kernel item with the lookahead #
+  /** The closure does not depend on the state the item is in, so it is
+   *  computed once and stored in #m_closures.
+   */
+  const closure_memo& get_closure(int rulenumber, int dotpos);
+
   //! Fills the #m_ext_items structure. Must not be called before compute_lr0_items()!
   void compute_lookaheads(void);
   
   //! Fills the #m_table structure. Must not be called before compute_lookaheads()!
   void build_table(void);
+
+  //! Computes the automaton and the table from the first sets. Used by make_lalr_table() and update().
+  void make_automaton(void);
+
+  //! Discards the memorized closures and transitions that depend on the given nonterminals
+  void forget_closures(const std::set<int>& changed);
   
   
 public:
   //! \brief The constructor takes the number of the nonterminals and allocates memory 
   //!        needed for processing the grammar
-  LalrTable(unsigned _nonterm_count)
-  : m_nonterm_count(_nonterm_count)
+  /** The token terminals, if any, are numbered from -257 downwards.
+   */
+  LalrTable(unsigned _nonterm_count, unsigned _token_count = 0)
+  : m_nonterm_count(_nonterm_count), m_token_count(_token_count)
   {
     m_firsts.resize(_nonterm_count);
     m_nont_firsts.resize(_nonterm_count);
@@ -259,16 +316,68 @@ public:
   
   //! The main processing procedure
   void make_lalr_table(void);
+
+  //! Rebuilds the table after new rules were added to the grammar.
+  /** The input must contain all the rules given to load() and the new ones.
+   *  The rules keep their numbers, the new rules are appended. Only the closures
+   *  and transitions that involve a nonterminal with new rules or a changed first
+   *  set are computed again, the rest of the automaton is reused.
+   *  The token terminals keep their numbers too, new tokens may be appended.
+   *  Returns false (and does nothing) if some rules or tokens were removed,
+   *  the table must be then built from scratch.
+   */
+  bool update(const std::multimap<int, std::vector<int> >& input, unsigned nonterm_count,
+    unsigned token_count = 0);
   
   //! Prints the table to the specified file. Must not be called before make_lalr_table()!
   void print_table(const std::string& file_name);
 
+  //! Writes the rules, the GLALR table and the go_to table to a stream.
+  /** Stores only the data needed for parsing. Must not be called before make_lalr_table()!
+   */
+  void write_table(std::ostream& out);
+
+  //! Reads the data written by write_table(), replaces make_lalr_table().
+  /** Returns false if the data are not consistent.
+   */
+  bool read_table(std::istream& in);
+
   //! Returns the set of possible action in specified state and lookahead.
   const std::set<action> & get_actions(int state, int lookahead)
   {
     return m_table.at(state).at(lookahead);
   }
 
+  //! Returns the number of the states
+  size_t get_state_count(void) const
+  {
+    return m_table.size();
+  }
+
+  //! Returns the number of the table columns: 256 chars, end_of_input and the tokens
+  unsigned get_column_count(void) const
+  {
+    return 1 + 256 + m_token_count;
+  }
+
+  //! Returns the number of the token terminals
+  unsigned get_token_count(void) const
+  {
+    return m_token_count;
+  }
+
+  //! Returns the index of the symbol in #m_go_to, the table column for terminals
+  unsigned get_symbol_index(int symbol) const
+  {
+    return (symbol <= 0) ? -symbol : symbol + 256 + m_token_count;
+  }
+
+  //! Returns the token columns with some actions in the specified state
+  const std::vector<int>& get_token_columns(int state) const
+  {
+    return m_token_columns[state];
+  }
+
   //! Returns the m_go_to[state][symbol] entry
   int get_go_to(int state, int symbol)
   {
@@ -287,6 +396,12 @@ public:
     return m_accepting_state;
   }
 
+  //! Returns the number of the rules
+  size_t get_rule_count(void)
+  {
+    return m_rules.size();
+  }
+
   //! Returns the length of the rule
   size_t get_rule_length(unsigned rulenumber)
   {
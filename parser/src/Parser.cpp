@@ -17,206 +17,1317 @@
  * $Id$
  */
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <sstream>
+#include <stdexcept>
+
 #include "Debug.h"
 #include "Parser.h"
 
+//! Returns the wall-clock time in milliseconds, used to check the time limit
+static unsigned long current_time(void)
+{
+#ifdef _WIN32
+  return GetTickCount();
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000UL + now.tv_usec / 1000;
+#endif
+}
+
+//! Returns a table version no parser has used yet
+static unsigned next_table_version(void)
+{
+#ifdef _WIN32
+  static LONG last_version = 0;
+  return static_cast<unsigned>(InterlockedIncrement(&last_version));
+#else
+  static unsigned last_version = 0;
+  return __sync_add_and_fetch(&last_version, 1);
+#endif
+}
+
+//! The node of an event that concerns no node
+static const unsigned no_node = UINT_MAX;
+
+//! Writes the nonterminal, a nonterminal generated by the loading as #number
+static void write_nonterminal(std::ostream& out, const AnyBnfLoad& names, int nonterm)
+{
+  std::string name = names.get_marked_name(nonterm);
+  if(name.empty())
+    out << '#' << nonterm;
+  else
+    out << name;
+}
+
+//! Returns the rule of the table in the ABNF notation, a token is written as <dfa>
+static std::string get_rule_text(LalrTable& table, const AnyBnfLoad& names, int rule)
+{
+  static const char digits[] = "0123456789ABCDEF";
+  std::ostringstream out;
+  bool quoted = false;
+
+  write_nonterminal(out, names, table.get_lhs(rule));
+  out << " =";
+  for(unsigned k = 0; k < table.get_rule_length(rule); k++)
+  {
+    int symbol = table.get_symbol(rule, k);
+    // the printable bytes in a row are written as one string
+    if(symbol <= 0 && -symbol > ' ' && -symbol < 127 && -symbol != '"')
+    {
+      if(!quoted)
+        out << " \"";
+      out << static_cast<char>(-symbol);
+      quoted = true;
+      continue;
+    }
+
+    if(quoted)
+      out << '"';
+    quoted = false;
+    out << ' ';
+    if(symbol > 0)
+      write_nonterminal(out, names, symbol);
+    else if(-symbol > 256)
+      out << "<dfa>";
+    else
+      out << "%x" << digits[-symbol / 16] << digits[-symbol % 16];
+  }
+  if(quoted)
+    out << '"';
+  return out.str();
+}
+
+void Parser::add_grammar(const char *grammar_name, const char *syntax_name)
+{
+  if(!m_cache.enabled())
+  {
+    m_grammar.add_grammar(grammar_name, syntax_name);
+    return;
+  }
+
+  // report missing files immediately, as without the cache
+  m_grammar.find_grammar_file(grammar_name);
+  m_pending_grammars.push_back(std::make_pair(std::string(grammar_name),
+    std::string(syntax_name ? syntax_name : "")));
+}
+
+void Parser::add_referenced_grammars()
+{
+  if(!m_cache.enabled())
+  {
+    m_grammar.add_referenced_grammars();
+    return;
+  }
+
+  m_pending_references = true;
+}
+
+void Parser::load_pending_grammars(void)
+{
+  for(; m_pending_loaded < m_pending_grammars.size(); m_pending_loaded++)
+  {
+    const std::pair<std::string, std::string>& pending = m_pending_grammars[m_pending_loaded];
+    m_grammar.add_grammar(pending.first.c_str(),
+      pending.second.empty() ? NULL : pending.second.c_str());
+  }
+
+  if(m_pending_references)
+    m_grammar.add_referenced_grammars();
+}
+
+std::string Parser::get_cache_key(void)
+{
+  GrammarCache::Digest digest;
+  std::vector<std::string>::const_iterator path;
+  std::vector<std::pair<std::string, std::string> >::const_iterator pending;
+  std::vector<std::pair<std::string, std::string> >::const_iterator start;
+
+  digest.update(PACKAGE_STRING);
+  for(start = m_grammar.get_start_symbols().begin(); start != m_grammar.get_start_symbols().end(); start++)
+  {
+    digest.update(start->first);
+    digest.update(start->second);
+  }
+
+  // search paths determine where the referenced grammars are found
+  for(path = m_grammar.get_search_paths().begin(); path != m_grammar.get_search_paths().end(); path++)
+    digest.update(*path);
+
+  for(pending = m_pending_grammars.begin(); pending != m_pending_grammars.end(); pending++)
+  {
+    digest.update(pending->first);
+    digest.update(pending->second);
+    digest.update(GrammarCache::digest_file(m_grammar.find_grammar_file(pending->first.c_str())));
+  }
+
+  digest.update(m_pending_references ? "references" : "");
+  digest.update(m_tokenizer.enabled() ? "tokens" : "");
+  return digest.hex();
+}
+
+void Parser::build_parser(void)
+{
+  std::string cache_key;
+
+  // the levels kept and the profile belong to the previous table, even
+  // when update() extends the same one
+  m_table_version = next_table_version();
+
+  if(m_cache.enabled())
+  {
+    cache_key = get_cache_key();
+    if(m_cache.read_entry(cache_key, m_grammar, m_tokenizer, m_prefilter, m_table))
+    {
+      compute_markup();
+      compute_recovery();
+      compute_lookahead();
+      return;
+    }
+
+    load_pending_grammars();
+  }
+
+  m_grammar.remove_unreachable();
+
+  // the regular nonterminals are replaced by tokens
+  std::multimap<int, std::vector<int> > grammar;
+  m_tokenizer.compile(m_grammar.get_grammar(), m_grammar.get_nonterm_count(), grammar);
+  m_prefilter.compute(m_grammar.get_grammar(), m_grammar.get_nonterm_count());
+  process_grammar(grammar, m_grammar.get_nonterm_count());
+  compute_markup();
+  compute_recovery();
+  compute_lookahead();
+
+  if(m_cache.enabled())
+    m_cache.write_entry(cache_key, m_grammar, m_tokenizer, m_prefilter, *m_table,
+      m_grammar.get_nonterm_count());
+}
+
+//! Returns the error found at the position, the parsing skipped from begin to end
+static BnfParser2::ErrorSpan error_span(size_t position, size_t begin, size_t end)
+{
+  BnfParser2::ErrorSpan error;
+  error.position = position;
+  error.begin = begin;
+  error.end = end;
+  return error;
+}
+
 bool Parser::parse_word(const std::string& word)
+{
+  if(!parse(word.data(), word.size()))
+    return false;
+
+  // the markup refers to the input, which may not outlive the call
+  m_accepted_word.assign(word, 0, m_match_length);
+  m_accepted_data = m_accepted_word.data();
+  return true;
+}
+
+bool Parser::parse(const char *word, size_t length)
+{
+  m_accepted_data = NULL;
+  reset_counters();
+  m_recorder.record(BnfEvent::Event_Begin, 0, -1, -1, no_node, no_node, length);
+
+  try
+  {
+    if(!parse_levels(word, length))
+    {
+      // rejected before the levels were parsed, e.g. by the prefilter
+      if(m_result_code == BnfParser2::Result_Rejected && m_errors.empty())
+      {
+        m_errors.push_back(error_span(m_error_position, m_error_position, length));
+      }
+      return record_end(false);
+    }
+
+    m_accepted_data = word;
+    return record_end(true);
+  }
+  catch(LimitExceeded& e)
+  {
+    logTrace(LOG_INFO, "parsing stopped at " << m_current_level << ", limit " << e.code << " exceeded");
+    m_last_accepted = false;
+    m_error_position = m_current_level;
+    m_result_code = e.code;
+    return record_end(false);
+  }
+}
+
+bool Parser::record_end(bool result)
+{
+  m_recorder.record(BnfEvent::Event_End, m_current_level, -1, -1, no_node, no_node, m_result_code);
+  return result;
+}
+
+GSS::StateIdent Parser::create_state(unsigned level, int state)
+{
+  GSS::StateIdent node = m_gss.create_state(level, state);
+  m_recorder.record(BnfEvent::Event_StateNode, m_current_level, state, -1, node.id, level, -1);
+  return node;
+}
+
+GSS::SymbolIdent Parser::create_symbol(int symbol, GSS::ValueIdent value, int rule)
+{
+  GSS::SymbolIdent node = m_gss.create_symbol(symbol, value, rule);
+  m_recorder.record(BnfEvent::Event_SymbolNode, m_current_level, -1, rule, node.id, no_node, symbol);
+  return node;
+}
+
+bool Parser::parse_document(const std::string& document)
+{
+  m_document = document;
+  return parse_edited(0);
+}
+
+bool Parser::reparse(size_t offset, size_t removed_length, const char *inserted, size_t inserted_length)
+{
+  if(offset > m_document.size() || removed_length > m_document.size() - offset)
+    throw std::out_of_range("Invalid edit");
+
+  m_document.replace(offset, removed_length, inserted, inserted_length);
+  return parse_edited(offset);
+}
+
+bool Parser::parse_edited(size_t position)
+{
+  m_keep_levels = true;
+  m_edit_position = position;
+  try
+  {
+    bool result = parse(m_document.data(), m_document.size());
+    m_keep_levels = false;
+    return result;
+  }
+  catch(...)
+  {
+    m_keep_levels = false;
+    throw;
+  }
+}
+
+void Parser::parse_words(const std::vector<std::string>& words,
+  std::vector<BnfParser2::WordResult>& results)
+{
+  const Parser *source = select_source();
+
+  results.resize(words.size());
+
+  // the whole grammar is regular, all words are run by one dfa
+  if(source->m_start_token != -1)
+  {
+    std::vector<bool> accepted;
+    std::vector<size_t> stops;
+    source->m_tokenizer.get_dfa(source->m_start_token).accepts(words, accepted, stops);
+
+    for(size_t k = 0; k < words.size(); k++)
+    {
+      results[k].code = accepted[k] ? BnfParser2::Result_Accepted : BnfParser2::Result_Rejected;
+      results[k].error_position = stops[k];
+    }
+    return;
+  }
+
+  // the words are matched as a whole
+  BnfParser2::MatchMode mode = m_match_mode;
+  m_match_mode = BnfParser2::Match_Whole;
+  for(size_t k = 0; k < words.size(); k++)
+  {
+    parse(words[k].data(), words[k].size());
+    results[k].code = m_result_code;
+    results[k].error_position = m_error_position;
+  }
+  m_match_mode = mode;
+  m_accepted_data = NULL;
+}
+
+bool Parser::search(const char *buffer, size_t length, std::vector<BnfParser2::Match>& matches)
+{
+  reset_counters();
+  matches.clear();
+  m_recorder.record(BnfEvent::Event_Begin, 0, -1, -1, no_node, no_node, length);
+
+  try
+  {
+    search_levels(buffer, length, matches);
+  }
+  catch(LimitExceeded& e)
+  {
+    logTrace(LOG_INFO, "search stopped at " << m_current_level << ", limit " << e.code << " exceeded");
+    m_error_position = m_current_level;
+    m_result_code = e.code;
+    return record_end(false);
+  }
+
+  m_result_code = BnfParser2::Result_Accepted;
+  return record_end(true);
+}
+
+void Parser::reset_counters(void)
+{
+  m_reduction_count = 0;
+  m_shift_count = 0;
+  m_path_steps = 0;
+  m_reductions_by_length.clear();
+  m_start_time = current_time();
+  m_current_level = 0;
+}
+
+void Parser::get_parse_stats(BnfParseStats& stats) const
+{
+  stats.state_nodes = m_gss.get_state_count();
+  stats.symbol_nodes = m_gss.get_symbol_count();
+  stats.edges = m_gss.get_edge_count();
+  stats.shifts = m_shift_count;
+  stats.reductions = m_reduction_count;
+  stats.reductions_by_length = m_reductions_by_length;
+  stats.path_steps = m_path_steps;
+  stats.max_level_width = m_gss.get_max_level_width();
+  stats.ambiguous_symbols = m_gss.get_ambiguous_count();
+  stats.semantic_bytes = m_gss.get_semantic_bytes();
+}
+
+void Parser::set_profiling(bool enabled)
+{
+  m_profiling = enabled;
+  m_profile_source = NULL;
+  m_profile_version = 0;
+  m_rule_reductions.clear();
+  m_rule_path_steps.clear();
+  m_state_splits.clear();
+}
+
+void Parser::get_profile(BnfProfile& profile) const
+{
+  profile.rules.clear();
+  profile.states.clear();
+  // the counts of a table built again are lost
+  if(m_profile_source == NULL || m_profile_source->m_table_version != m_profile_version)
+    return;
+
+  LalrTable& table = *m_profile_source->m_table;
+  const AnyBnfLoad& names = m_profile_source->m_grammar;
+
+  // a generated nonterminal belongs to the named one it was generated for
+  std::map<int, int> owners;
+  for(unsigned rule = 0; rule < table.get_rule_count(); rule++)
+    if(!names.get_marked_name(table.get_lhs(rule)).empty())
+      owners[table.get_lhs(rule)] = table.get_lhs(rule);
+  bool changed = true;
+  while(changed)
+  {
+    changed = false;
+    for(unsigned rule = 0; rule < table.get_rule_count(); rule++)
+    {
+      std::map<int, int>::const_iterator owner = owners.find(table.get_lhs(rule));
+      if(owner == owners.end())
+        continue;
+      for(unsigned k = 0; k < table.get_rule_length(rule); k++)
+        if(table.get_symbol(rule, k) > 0
+          && owners.insert(std::make_pair(table.get_symbol(rule, k), owner->second)).second)
+          changed = true;
+    }
+  }
+
+  for(unsigned rule = 0; rule < m_rule_reductions.size(); rule++)
+  {
+    if(m_rule_reductions[rule] == 0 && m_rule_path_steps[rule] == 0)
+      continue;
+
+    profile.rules.push_back(BnfRuleProfile());
+    BnfRuleProfile& entry = profile.rules.back();
+    std::map<int, int>::const_iterator owner = owners.find(table.get_lhs(rule));
+    if(owner != owners.end())
+    {
+      entry.grammar = names.get_grammar_name(owner->second);
+      entry.nonterminal = names.get_marked_name(owner->second);
+    }
+    entry.rule = get_rule_text(table, names, rule);
+    entry.reductions = m_rule_reductions[rule];
+    entry.path_steps = m_rule_path_steps[rule];
+  }
+
+  for(unsigned state = 0; state < m_state_splits.size(); state++)
+  {
+    if(m_state_splits[state] == 0)
+      continue;
+
+    profile.states.push_back(BnfStateProfile());
+    BnfStateProfile& entry = profile.states.back();
+    entry.state = state;
+    entry.splits = m_state_splits[state];
+
+    std::set<int> rules;
+    for(unsigned column = 0; column < table.get_column_count(); column++)
+    {
+      const std::set<LalrTable::action>& actions = table.get_actions(state, column);
+      if(actions.size() > 1)
+        for(std::set<LalrTable::action>::const_iterator pos = actions.begin(); pos != actions.end(); pos++)
+          if(pos->what == LalrTable::action::reduce)
+            rules.insert(pos->reduce_by);
+    }
+    for(std::set<int>::const_iterator pos = rules.begin(); pos != rules.end(); pos++)
+      entry.rules.push_back(get_rule_text(table, names, *pos));
+  }
+}
+
+void Parser::check_limits(void)
+{
+  if(m_limits.max_reductions != 0 && m_reduction_count > m_limits.max_reductions)
+    throw LimitExceeded(BnfParser2::Result_ReductionLimit);
+  if(m_limits.max_nodes != 0 && m_gss.get_node_count() > m_limits.max_nodes)
+    throw LimitExceeded(BnfParser2::Result_NodeLimit);
+  if(m_limits.max_edges != 0 && m_gss.get_edge_count() > m_limits.max_edges)
+    throw LimitExceeded(BnfParser2::Result_EdgeLimit);
+  if(m_limits.max_semantic_bytes != 0
+    && m_gss.get_semantic_bytes() > m_limits.max_semantic_bytes)
+    throw LimitExceeded(BnfParser2::Result_SemanticLimit);
+  if(m_limits.max_time != 0 && current_time() - m_start_time > m_limits.max_time)
+    throw LimitExceeded(BnfParser2::Result_TimeLimit);
+}
+
+const Parser *Parser::select_source(void)
+{
+  const Parser *source = (m_source != NULL) ? m_source : this;
+  if(source->m_table == NULL)
+    throw std::runtime_error("Parser not built");
+  m_parse_table = source->m_table;
+  m_parse_markup = &source->m_markup;
+  m_parse_mark_names = &source->m_mark_names;
+  m_parse_lookahead = &source->m_lookahead;
+  m_parse_tokens = &source->m_tokenizer;
+
+  if(m_profiling && (m_profile_source != source || m_profile_version != source->m_table_version))
+  {
+    // the counts of another table cannot be added up
+    m_profile_source = source;
+    m_profile_version = source->m_table_version;
+    m_rule_reductions.assign(m_parse_table->get_rule_count(), 0);
+    m_rule_path_steps.assign(m_parse_table->get_rule_count(), 0);
+    m_state_splits.assign(m_parse_table->get_state_count(), 0);
+  }
+  return source;
+}
+
+void Parser::reset_levels(const char *word, size_t length)
+{
+  m_word = word;
+  m_word_length = length;
+  m_gss.reset(length);
+  m_accepted_value = GSS::no_markup;
+  m_q.clear();
+  m_r.clear();
+  m_paths.clear();
+  m_token_matches.clear();
+  m_token_starts.clear();
+  m_pending_tokens.clear();
+  m_token_reach = 0;
+  m_reduce_all = false;
+  m_errors.clear();
+  m_kept_source = NULL;
+  m_checkpoints.clear();
+  m_token_shifts.clear();
+  m_max_token_span = 0;
+  m_read_reach = 0;
+}
+
+void Parser::keep_level(unsigned level)
+{
+  if(m_checkpoints.size() <= level)
+    m_checkpoints.resize(level + 1);
+
+  LevelCheckpoint& checkpoint = m_checkpoints[level];
+  checkpoint.gss = m_gss.get_checkpoint();
+  checkpoint.token_shifts = m_token_shifts.size();
+  checkpoint.errors = m_errors.size();
+  checkpoint.token_reach = m_token_reach;
+  // the actions of the level depend on the next byte
+  checkpoint.read_reach = std::max<size_t>(m_read_reach, level);
+}
+
+unsigned Parser::restore_levels(void)
+{
+  // the last level whose parsing read nothing after the edit
+  size_t level = std::min(m_checkpoints.size(), m_edit_position);
+  while(level > 0 && m_checkpoints[level - 1].read_reach >= m_edit_position)
+    level--;
+  if(level == 0)
+    return 0;
+
+  logTrace(LOG_INFO, "levels before " << level << " reused");
+  const LevelCheckpoint checkpoint = m_checkpoints[level - 1];
+  m_checkpoints.resize(level);
+  m_gss.truncate(checkpoint.gss, level, m_word_length);
+  m_errors.erase(m_errors.begin() + checkpoint.errors, m_errors.end());
+  m_token_reach = checkpoint.token_reach;
+  m_read_reach = checkpoint.read_reach;
+  m_accepted_value = GSS::no_markup;
+  m_reduce_all = false;
+  m_r.clear();
+
+  // the tokens pending after the level, each was queued at most the longest span before its end
+  m_token_shifts.erase(m_token_shifts.begin() + checkpoint.token_shifts, m_token_shifts.end());
+  m_pending_tokens.clear();
+  for(size_t k = m_token_shifts.size(); k > 0; k--)
+  {
+    const TokenShift& token = m_token_shifts[k - 1];
+    if(token.queued + m_max_token_span < level)
+      break;
+    if(token.end >= level)
+      m_pending_tokens[token.end].insert(std::make_pair(token.shift, token.column));
+  }
+
+  // the results computed for the levels from the shifted one may depend on the edit
+  m_token_matches.erase(m_token_matches.lower_bound(std::make_pair(std::make_pair(level, INT_MIN), INT_MIN)),
+    m_token_matches.end());
+  m_token_starts.erase(m_token_starts.lower_bound(std::make_pair(level, INT_MIN)), m_token_starts.end());
+  m_paths.erase(m_paths.lower_bound(std::make_pair(GSS::StateIdent(level, 0), 0U)), m_paths.end());
+
+  // the char shifts of the last level, as queued by queue_actions()
+  m_q.clear();
+  int column = static_cast<unsigned char>(m_word[level - 1]);
+  for(unsigned id = 0; id < m_gss.get_level_size(level - 1); id++)
+  {
+    GSS::StateIdent node(level - 1, id);
+    const std::set<LalrTable::action>& actions = m_parse_table->get_actions(m_gss.get_state_label(node), column);
+    for(std::set<LalrTable::action>::const_iterator pos = actions.begin(); pos != actions.end(); pos++)
+      if(pos->what == LalrTable::action::shift)
+        m_q.insert(QMember(node, pos->next_state));
+  }
+
+  return level;
+}
+
+bool Parser::parse_levels(const char *word, size_t length)
 {
   GSS::StateIdent initial_state;
   GSS::SymbolIdent not_an_ident;
-  int first_character;
+
+  const Parser *source = select_source();
+  int target = find_target(source);
+
+  // an edited document, the levels before the edit are parsed already
+  if(m_keep_levels && m_kept_source == source && m_kept_version == source->m_table_version
+    && m_kept_target == target
+    && m_match_mode == BnfParser2::Match_Whole)
+  {
+    m_word = word;
+    m_word_length = length;
+    unsigned level = restore_levels();
+    if(level != 0)
+    {
+      m_current_level = level - 1;
+      shifter(level - 1, -static_cast<int>(static_cast<unsigned char>(word[level - 1])));
+      check_limits();
+      return parse_from(source, target, level);
+    }
+  }
+
+  m_errors.clear();
+  m_kept_source = NULL;
+  // no gss is built for a word rejected by the prefilter or recognized by a dfa
+  m_gss.reset(0);
+
+  // the checks apply to the whole word only, and find the first error only
+  size_t stop;
+  if(m_prefilter_enabled && m_match_mode == BnfParser2::Match_Whole && source->m_recovery_symbols.empty()
+    && !m_keep_levels && !source->m_prefilter.check(word, length, stop))
+  {
+    m_last_accepted = false;
+    m_error_position = stop;
+    m_result_code = BnfParser2::Result_Rejected;
+    m_recorder.record(BnfEvent::Event_Error, stop, -1, -1, no_node, no_node, -1);
+    return false;
+  }
+
+  // the whole grammar is regular, the gss is not needed
+  if(source->m_start_token != -1)
+  {
+    // several start symbols are never regular
+    m_matched_symbols.assign(1, source->m_start_names[0]);
+    return parse_regular(word, length, m_parse_tokens->get_dfa(source->m_start_token));
+  }
+
+  reset_levels(word, length);
+  m_prefix_ends = (m_match_mode != BnfParser2::Match_Whole);
+  if(m_keep_levels && m_match_mode == BnfParser2::Match_Whole)
+  {
+    m_kept_source = source;
+    m_kept_version = source->m_table_version;
+    m_kept_target = target;
+  }
+
+  initial_state = create_state(0, 0);
+  queue_actions(initial_state, 0, 0, not_an_ident, NULL, true, m_q);
+
+  return parse_from(source, target, 0);
+}
+
+bool Parser::parse_from(const Parser *source, int target, unsigned first)
+{
+  GSS::StateIdent initial_state(0, 0);
+  const char *word = m_word;
+  size_t length = m_word_length;
   unsigned i;
-  int a_i_1, a_i_2;
+  int a_i_1;
+  bool matched = false;
 
-  std::set<LalrTable::action>::const_iterator actions;
-  
-  std::vector<GSS::StateIdent> accepting_states;
-  m_gss.reset(word.length());
-  m_q.clear();
-  m_r.clear();
+  for(i = first; i <= length; i++)
+  {
+    if(i < length)
+      a_i_1 = -static_cast<int>(static_cast<unsigned char>(word[i]));
+    else
+      a_i_1 = LalrTable::end_of_input;
+
+    m_current_level = i;
+    shift_tokens(i);
+
+    if(m_gss.state_level_empty(i))
+    {
+      // the level is inside the tokens being shifted
+      if(!m_pending_tokens.empty())
+        continue;
+      break;
+    }
+
+    while(!m_r.empty())
+    {
+      m_reduction_count++;
+      check_limits();
+      reducer(i);
+    }
+
+    // the end of input reductions were done at this level too, see get_columns()
+    if(m_match_mode != BnfParser2::Match_Whole && i != length
+      && accept_level(source, target, i, initial_state))
+    {
+      matched = true;
+      m_match_length = i;
+      if(m_match_mode == BnfParser2::Match_Shortest)
+        break;
+    }
+
+    if(i != length)
+    {
+      if(m_q.empty() && m_pending_tokens.empty())
+      {
+        // no stack continues, the longest prefix was found
+        if(matched)
+          break;
+        if(recover(source, i, std::max<size_t>(i, m_token_reach)))
+          continue;
+        return reject(std::max<size_t>(i, m_token_reach));
+      }
+      else
+      {
+        if(m_kept_source != NULL)
+          keep_level(i);
+        shifter(i, a_i_1);
+        check_limits();
+      }
+    }
+  }
 
-  initial_state = m_gss.create_state(0, 0);
-  if(word.length() > 0)
-    first_character = static_cast<int>(static_cast<unsigned char>(word[0]));
+  if(!m_errors.empty() && (matched || accept_level(source, target, length, initial_state)))
+  {
+    // the rest of the word is valid, the errors were recovered from
+    m_last_accepted = false;
+    m_error_position = m_errors.front().position;
+    m_result_code = BnfParser2::Result_Rejected;
+    return false;
+  }
+  else if(!(matched && m_match_mode == BnfParser2::Match_Shortest)
+    && accept_level(source, target, length, initial_state))
+  {
+    m_last_accepted = true;
+    m_result_code = BnfParser2::Result_Accepted;
+    m_match_length = length;
+    return true;
+  }
+  else if(matched)
+  {
+    m_last_accepted = true;
+    m_result_code = BnfParser2::Result_Accepted;
+    return true;
+  }
   else 
-    first_character = -LalrTable::end_of_input;
+    return reject(std::max<size_t>(i - 1, m_token_reach));
+}
+
+bool Parser::reject(size_t position)
+{
+  m_errors.push_back(error_span(position, position, m_word_length));
+  m_recorder.record(BnfEvent::Event_Error, position, -1, -1, no_node, no_node, -1);
+
+  m_last_accepted = false;
+  m_error_position = m_errors.front().position;
+  m_result_code = BnfParser2::Result_Rejected;
+  return false;
+}
+
+bool Parser::recover(const Parser *source, unsigned level, size_t position)
+{
+  const std::vector<RecoverySymbol>& recovery = source->m_recovery_symbols;
+  size_t begin = 0;
+  size_t resume = m_word_length + 1;
+  if(recovery.empty())
+    return false;
+
+  // the reductions the lookahead prevented, e.g. of the symbol before the error
+  m_reduce_all = true;
+  for(unsigned id = 0; id < m_gss.get_level_size(level); id++)
+  {
+    GSS::StateIdent node(level, id);
+    int state = m_gss.get_state_label(node);
+    const std::vector<GSS::SymbolIdent>& symbols = m_gss.get_state_successors(node);
+    if(symbols.empty())
+      queue_actions(node, state, level, GSS::SymbolIdent(), NULL, true, m_q);
+    for(unsigned k = 0; k < symbols.size(); k++)
+    {
+      const std::vector<GSS::StateIdent>& previous = m_gss.get_symbol_successors(symbols[k]);
+      for(unsigned l = 0; l < previous.size(); l++)
+        queue_actions(node, state, level, symbols[k], &previous[l], true, m_q);
+    }
+  }
+  while(!m_r.empty())
+  {
+    m_reduction_count++;
+    check_limits();
+    reducer(level);
+  }
+  m_reduce_all = false;
+
+  for(unsigned k = 0; k < recovery.size(); k++)
+  {
+    const std::string& terminator = recovery[k].terminator;
+    if(terminator.empty())
+      continue;
+
+    // the erroneous symbol starts after the last terminator before the error
+    const char *last = std::find_end(m_word, m_word + position, terminator.begin(), terminator.end());
+    size_t bound = (last == m_word + position) ? 0 : (last - m_word) + terminator.size();
+
+    // and ends with the first terminator not ending before the error
+    size_t from = position + 1 - std::min(position + 1, terminator.size());
+    const char *end = std::search(m_word + from, m_word + m_word_length,
+      terminator.begin(), terminator.end());
+    if(end == m_word + m_word_length)
+    {
+      m_read_reach = m_word_length;
+      continue;
+    }
+    size_t stop = (end - m_word) + terminator.size();
+    m_read_reach = std::max(m_read_reach, stop);
+
+    // the first level after the bound the symbol may start at
+    bool found = false;
+    for(unsigned start = std::min<size_t>(bound, level); start <= level && !found; start++)
+      for(unsigned id = 0; id < m_gss.get_level_size(start); id++)
+      {
+        GSS::StateIdent node(start, id);
+        for(unsigned l = 0; l < recovery[k].symbols.size(); l++)
+        {
+          int symbol = recovery[k].symbols[l];
+          int state = m_parse_table->get_go_to(m_gss.get_state_label(node),
+            m_parse_table->get_symbol_index(symbol));
+          if(state == -1)
+            continue;
+
+          // the symbol is shifted like a token
+          queue_token(QMember(node, state), stop, -symbol);
+          if(!found && stop < resume)
+          {
+            begin = start;
+            resume = stop;
+          }
+          found = true;
+        }
+      }
+  }
+
+  if(resume > m_word_length)
+    return false;
+
+  logTrace(LOG_INFO, "error at " << position << ", skipped from " << begin << " to " << resume);
+  m_errors.push_back(error_span(position, begin, resume));
+  m_recorder.record(BnfEvent::Event_Error, position, -1, -1, no_node, no_node, resume);
+  return true;
+}
+
+void Parser::compute_recovery(void)
+{
+  for(unsigned k = 0; k < m_recovery_symbols.size(); k++)
+  {
+    RecoverySymbol& recovery = m_recovery_symbols[k];
+    std::vector<int> symbols = m_grammar.find_nonterminals(recovery.name);
+
+    // a nonterminal inside a token has no rules
+    recovery.symbols.clear();
+    for(unsigned l = 0; l < symbols.size(); l++)
+      for(unsigned rule = 1; rule < m_table->get_rule_count(); rule++)
+        if(m_table->get_lhs(rule) == symbols[l])
+        {
+          recovery.symbols.push_back(symbols[l]);
+          break;
+        }
+
+    if(recovery.symbols.empty())
+    {
+      BnfReport report(m_interface->get_reporter(), BnfReporter::ErrorType_Warning);
+      report.text()
+        << "Recovery symbol \"" << recovery.name << "\" is not a nonterminal of the parser.";
+    }
+  }
+}
+
+void Parser::search_levels(const char *buffer, size_t length, std::vector<BnfParser2::Match>& matches)
+{
+  GSS::SymbolIdent not_an_ident;
+  BnfParser2::Match match;
+  unsigned i, k, l;
+
+  const Parser *source = select_source();
+  const std::bitset<256>& first_bytes = (*m_parse_lookahead)[0];
+
+  // the regular grammar, the longest match at each position the dfa starts at
+  if(source->m_start_token != -1)
+  {
+    const Tokenizer::Dfa& dfa = m_parse_tokens->get_dfa(source->m_start_token);
+    std::bitset<256> live;
+    std::vector<unsigned> ends;
+    live.set();
+
+    for(i = 0; i < length; i++)
+    {
+      if(!first_bytes[static_cast<unsigned char>(buffer[i])])
+        continue;
+      ends.clear();
+      dfa.match(buffer, length, i, live, ends);
+      if(!ends.empty())
+      {
+        match.begin = i;
+        match.end = ends.back();
+        matches.push_back(match);
+        i = match.end - 1;
+      }
+    }
+    return;
+  }
+
+  // the end of the longest match starting at each level, all the attempts share the gss
+  std::vector<unsigned> longest(length, 0);
+
+  reset_levels(buffer, length);
+  m_prefix_ends = true;
+
+  for(i = 0; i <= length; i++)
+  {
+    m_current_level = i;
+    shift_tokens(i);
+
+    // a new attempt starts where the start symbol may start
+    if(i < length && first_bytes[static_cast<unsigned char>(buffer[i])])
+    {
+      GSS::StateIdent initial_state = create_state(i, 0);
+      queue_actions(initial_state, 0, i, not_an_ident, NULL, true, m_q);
+    }
+
+    if(m_gss.state_level_empty(i))
+      continue;
+
+    while(!m_r.empty())
+    {
+      m_reduction_count++;
+      check_limits();
+      reducer(i);
+    }
+
+    // each start symbol of an accepting state spans from the initial state it follows
+    std::vector<GSS::StateIdent> accepting_states = m_gss.find_state(i, m_parse_table->get_accepting_state());
+    for(k = 0; k < accepting_states.size(); k++)
+    {
+      const std::vector<GSS::SymbolIdent>& symbols = m_gss.get_state_successors(accepting_states[k]);
+      for(l = 0; l < symbols.size(); l++)
+      {
+        const std::vector<GSS::StateIdent>& starts = m_gss.get_symbol_successors(symbols[l]);
+        for(unsigned m = 0; m < starts.size(); m++)
+          if(m_gss.get_state_level(starts[m]) < i)
+            longest[m_gss.get_state_level(starts[m])] = i;
+      }
+    }
+
+    if(i != length && !m_q.empty())
+    {
+      shifter(i, -static_cast<int>(static_cast<unsigned char>(buffer[i])));
+      check_limits();
+    }
+  }
+
+  // the leftmost longest matches, not overlapping
+  for(i = 0; i < length; i++)
+  {
+    if(longest[i] == 0)
+      continue;
+    match.begin = i;
+    match.end = longest[i];
+    matches.push_back(match);
+    i = match.end - 1;
+  }
+}
+
+int Parser::find_target(const Parser *source) const
+{
+  if(m_target_symbol.empty())
+    return -1;
+
+  for(unsigned k = 0; k < source->m_start_names.size(); k++)
+    if(source->m_start_names[k] == m_target_symbol)
+      return k;
+
+  throw std::runtime_error("Symbol \"" + m_target_symbol + "\" is not a start symbol");
+}
+
+bool Parser::accept_level(const Parser *source, int target, unsigned level,
+  const GSS::StateIdent& initial_state)
+{
+  std::vector<std::string> matched;
+  GSS::ValueIdent value = GSS::no_markup;
+  unsigned k, l, m;
+
+  for(k = 0; k < source->m_start_states.size(); k++)
+  {
+    if(target != -1 && static_cast<int>(k) != target)
+      continue;
+
+    // the start symbol spans the input from the initial state up to the level
+    std::vector<GSS::StateIdent> states = m_gss.find_state(level, source->m_start_states[k]);
+    for(l = 0; l < states.size(); l++)
+    {
+      const std::vector<GSS::SymbolIdent>& symbols = m_gss.get_state_successors(states[l]);
+      for(m = 0; m < symbols.size(); m++)
+        if(m_gss.has_state_successor(symbols[m], initial_state))
+          break;
+
+      if(m < symbols.size())
+      {
+        if(matched.empty())
+          value = m_gss.get_value(symbols[m], m_gss.get_state_level(initial_state), level);
+        matched.push_back(source->m_start_names[k]);
+        break;
+      }
+    }
+  }
+
+  if(matched.empty())
+    return false;
+
+  m_matched_symbols.swap(matched);
+  m_accepted_value = value;
+  return true;
+}
+
+bool Parser::parse_regular(const char *word, size_t length, const Tokenizer::Dfa& dfa)
+{
+  size_t stop;
+
+  if(m_match_mode == BnfParser2::Match_Whole)
+  {
+    m_last_accepted = dfa.accepts(word, length, stop);
+    m_match_length = length;
+  }
+  else
+  {
+    std::bitset<256> live;
+    std::vector<unsigned> ends;
+    live.set();
+
+    // the empty prefix is not reported by match()
+    if(dfa.accepting[0])
+      ends.push_back(0);
+    if(ends.empty() || m_match_mode == BnfParser2::Match_Longest)
+      stop = dfa.match(word, length, 0, live, ends);
+
+    m_last_accepted = !ends.empty();
+    if(m_last_accepted)
+      m_match_length = (m_match_mode == BnfParser2::Match_Shortest) ? ends.front() : ends.back();
+  }
+
+  if(m_last_accepted)
+  {
+    m_result_code = BnfParser2::Result_Accepted;
+    // without marked nonterminals the semantic string is the word itself
+    m_accepted_value = GSS::no_markup;
+  }
+  else
+  {
+    m_error_position = stop;
+    m_result_code = BnfParser2::Result_Rejected;
+    m_recorder.record(BnfEvent::Event_Error, m_error_position, -1, -1, no_node, no_node, -1);
+  }
+  return m_last_accepted;
+}
+
+const Parser::TokenMatch& Parser::match_token(unsigned level, int column, int new_state)
+{
+  std::pair<std::pair<unsigned, int>, int> key(std::make_pair(level, column), new_state);
+  std::map<std::pair<std::pair<unsigned, int>, int>, TokenMatch>::iterator pos = m_token_matches.find(key);
+  if(pos != m_token_matches.end())
+    return pos->second;
+
+  // a prefix may end after any token
+  std::bitset<256> live = (*m_parse_lookahead)[new_state];
+  if(m_prefix_ends)
+    live.set();
+
+  TokenMatch& match = m_token_matches[key];
+  match.stop = m_parse_tokens->get_dfa(column).match(m_word, m_word_length, level, live, match.ends);
+  return match;
+}
+
+bool Parser::token_matches(unsigned level, int column, size_t& stop)
+{
+  std::pair<unsigned, int> key(level, column);
+  std::map<std::pair<unsigned, int>, std::pair<bool, size_t> >::iterator pos = m_token_starts.find(key);
+  if(pos == m_token_starts.end())
+  {
+    std::pair<bool, size_t> result;
+    result.first = m_parse_tokens->get_dfa(column).matches(m_word, m_word_length, level, result.second);
+    pos = m_token_starts.insert(std::make_pair(key, result)).first;
+  }
+
+  stop = pos->second.second;
+  m_read_reach = std::max(m_read_reach, stop);
+  return pos->second.first;
+}
+
+void Parser::get_columns(int state, unsigned level, std::vector<int>& columns)
+{
+  columns.clear();
+  if(m_reduce_all)
+  {
+    for(unsigned column = 0; column < m_parse_table->get_column_count(); column++)
+      columns.push_back(column);
+    return;
+  }
 
-  for(actions = m_table->get_actions(0, first_character).begin();
-      actions != m_table->get_actions(0, first_character).end();
-      actions++)
+  if(level < m_word_length)
   {
-    if(actions->what == LalrTable::action::shift)
-      m_q.insert(QMember(initial_state, actions->next_state));
-    else if(actions->reduce_length == 0)
-      m_r.insert(RMember(initial_state, actions->reduce_by, 0, not_an_ident));
+    columns.push_back(static_cast<unsigned char>(m_word[level]));
+    // a prefix may end here, the end of input has the reductions only
+    if(m_prefix_ends)
+      columns.push_back(-LalrTable::end_of_input);
   }
+  else
+    columns.push_back(-LalrTable::end_of_input);
 
-  for(i = 0; i <= word.size(); i++)
+  const std::vector<int>& tokens = m_parse_table->get_token_columns(state);
+  for(unsigned k = 0; k < tokens.size(); k++)
   {
-    if(i < word.size())
-      a_i_1 = -static_cast<int>(static_cast<unsigned char>(word[i]));
+    size_t stop;
+    if(token_matches(level, tokens[k], stop))
+      columns.push_back(tokens[k]);
     else
-      a_i_1 = LalrTable::end_of_input;
-      
-    if(i < word.size() - 1)
-      a_i_2 = -static_cast<int>(static_cast<unsigned char>(word[i + 1]));
-    else
-      a_i_2 = LalrTable::end_of_input;
-      
-    
-    if(m_gss.state_level_empty(i))
-      break;
+    {
+      // a byte by byte parser would get to the stop position
+      const std::set<LalrTable::action>& actions = m_parse_table->get_actions(state, tokens[k]);
+      for(std::set<LalrTable::action>::const_iterator pos = actions.begin(); pos != actions.end(); pos++)
+        if(pos->what == LalrTable::action::shift)
+          m_token_reach = std::max(m_token_reach, stop);
+    }
+  }
+}
 
-    while(!m_r.empty())
-      reducer(i, a_i_1);
+void Parser::queue_shift(const GSS::StateIdent& node, int new_state, unsigned level, int column,
+  std::set<QMember>& next_q)
+{
+  if(column <= -LalrTable::end_of_input)
+  {
+    next_q.insert(QMember(node, new_state));
+    return;
+  }
+
+  // the token is shifted when the parser gets to its end
+  const TokenMatch& match = match_token(level, column, new_state);
+  for(unsigned k = 0; k < match.ends.size(); k++)
+    queue_token(QMember(node, new_state), match.ends[k], column);
+  m_token_reach = std::max(m_token_reach, match.stop);
+  m_read_reach = std::max(m_read_reach, match.stop);
+}
+
+void Parser::queue_token(const QMember& shift, unsigned end, int column)
+{
+  m_pending_tokens[end].insert(std::make_pair(shift, column));
+  if(m_kept_source != NULL)
+  {
+    m_token_shifts.push_back(TokenShift(m_current_level, end, shift, column));
+    m_max_token_span = std::max(m_max_token_span, end - m_current_level);
+  }
+}
+
+void Parser::queue_actions(const GSS::StateIdent& node, int state, unsigned level,
+  const GSS::SymbolIdent& symbol, const GSS::StateIdent *previous, bool created,
+  std::set<QMember>& next_q)
+{
+  std::set<LalrTable::action>::const_iterator actions;
+  std::vector<int> columns;
 
-    if(i != word.size())
+  get_columns(state, level, columns);
+  for(unsigned k = 0; k < columns.size(); k++)
+  {
+    const std::set<LalrTable::action>& column_actions = m_parse_table->get_actions(state, columns[k]);
+    // the stack splits, the forced reductions of recover() excepted
+    if(m_profiling && created && column_actions.size() > 1 && !m_reduce_all)
+      m_state_splits[state]++;
+    for(actions = column_actions.begin(); actions != column_actions.end(); actions++)
     {
-      if(m_q.empty())
+      if(created)
       {
-        m_last_accepted = false;
-        m_error_position = i;
-        return false;
+        if(actions->what == LalrTable::action::shift && m_reduce_all)
+          continue;
+        else if(actions->what == LalrTable::action::shift)
+          queue_shift(node, actions->next_state, level, columns[k], next_q);
+        else if(actions->reduce_length == 0)
+          m_r.insert(RMember(node, actions->reduce_by, 0, symbol));
       }
-      else
-        shifter(i, a_i_1, a_i_2);
+
+      if(previous != NULL && actions->what == LalrTable::action::reduce && actions->reduce_length > 0)
+        m_r.insert(RMember(*previous, actions->reduce_by, actions->reduce_length, symbol));
     }
   }
+}
 
-  accepting_states = m_gss.find_state(word.size(), m_table->get_accepting_state());
-
+void Parser::shifter(unsigned i, int a_i_plus_1)
+{
+  std::set<QMember> temp_q;
+  std::set<QMember>::iterator q_iter;
 
-  if(accepting_states.size() > 0)
+  for(q_iter = m_q.begin(); q_iter != m_q.end(); q_iter++)
   {
-    m_last_accepted = true;
-    m_semantic_string = m_gss.get_semantic_string(m_gss.get_state_successors(accepting_states[0])[0]);
-    return true;
+    logTrace(LOG_DEBUG, "(" << i <<  ") shift " << q_iter->new_state);
+    shift(*q_iter, i + 1, a_i_plus_1, temp_q);
   }
-  else 
+
+  m_q = temp_q;
+}
+
+void Parser::shift_tokens(unsigned level)
+{
+  std::map<unsigned, std::set<std::pair<QMember, int> > >::iterator pending = m_pending_tokens.find(level);
+  if(pending == m_pending_tokens.end())
+    return;
+
+  std::set<std::pair<QMember, int> > shifts;
+  shifts.swap(pending->second);
+  m_pending_tokens.erase(pending);
+
+  for(std::set<std::pair<QMember, int> >::iterator pos = shifts.begin(); pos != shifts.end(); pos++)
   {
-    m_last_accepted = false;
-    m_error_position = i - 1;
-    return false;
+    unsigned start = m_gss.get_state_level(pos->first.state_node);
+    logTrace(LOG_DEBUG, "(" << start <<  ") shift token " << pos->second << " to " << level
+      << ", state " << pos->first.new_state);
+    shift(pos->first, level, -pos->second, m_q);
   }
 }
 
-void Parser::shifter(unsigned i, int a_i_plus_1, int a_i_plus_2)
+void Parser::shift(const QMember& shift, unsigned level, int label, std::set<QMember>& next_q)
 {
-  std::set<LalrTable::action>::const_iterator actions;
-  
-  std::set<QMember> temp_q;
-  std::set<QMember>::iterator q_iter;
-  std::vector<GSS::StateIdent> state_with_label, successors_with_label, successors_of_symbol;
+  m_shift_count++;
+  m_recorder.record(BnfEvent::Event_Shift, level, shift.new_state, -1, shift.state_node.id,
+    shift.state_node.level, -label);
+
+  // the terminals have no markup, their text is given by the position
+  GSS::ValueIdent value = GSS::no_markup;
+  std::vector<GSS::StateIdent> state_with_label;
   std::vector<GSS::SymbolIdent> symbol_with_label;
   GSS::SymbolIdent temp_symbol;
   GSS::StateIdent temp_state;
   unsigned k, l, m;
   bool found_state_node;
-  std::string helper;
-  helper = static_cast<char>(-a_i_plus_1);
-
-  for(q_iter = m_q.begin(); q_iter != m_q.end(); q_iter++)
-  {
-    logTrace(LOG_DEBUG, "(" << i <<  ") shift " << q_iter->new_state);
 
-    state_with_label = m_gss.find_state(i + 1, q_iter->new_state);
+  state_with_label = m_gss.find_state(level, shift.new_state);
 
-    if(!state_with_label.empty())
+  if(!state_with_label.empty())
+  {
+    for(k = 0; k < state_with_label.size(); k++)  //always runs only once
     {
-      for(k = 0; k < state_with_label.size(); k++)  //always runs only once
+      symbol_with_label = m_gss.get_state_successors_with_label(state_with_label[k], label);
+
+      found_state_node = false;
+      if(!symbol_with_label.empty())
       {
-        symbol_with_label = m_gss.get_state_successors_with_label(state_with_label[k], a_i_plus_1);
-        
-        found_state_node = false;
-        if(!symbol_with_label.empty())
+        for(m = 0; m < symbol_with_label.size(); m++)
+        {
+          const std::vector<GSS::StateIdent>& successors_of_symbol = m_gss.get_symbol_successors(symbol_with_label[m]);
+          for(l = 0; l < successors_of_symbol.size(); l++)
+            if(successors_of_symbol[l] == shift.state_node)
+            {
+              found_state_node = true;
+              m_gss.add_semantics_to_symbol(symbol_with_label[m], value);
+              temp_symbol = symbol_with_label[m];
+              break;
+            }
+          if(found_state_node)
+            break;
+        }
+        if(found_state_node == false)
         {
           for(m = 0; m < symbol_with_label.size(); m++)
           {
-            successors_of_symbol = m_gss.get_symbol_successors(symbol_with_label[m]);
+            const std::vector<GSS::StateIdent>& successors_of_symbol = m_gss.get_symbol_successors(symbol_with_label[m]);
             for(l = 0; l < successors_of_symbol.size(); l++)
-              if(successors_of_symbol[l] == q_iter->state_node)
+              if(m_gss.get_state_level(successors_of_symbol[l]) == m_gss.get_state_level(shift.state_node))
               {
                 found_state_node = true;
-                m_gss.add_semantics_to_symbol(symbol_with_label[m], helper);
+                m_gss.add_successor_to_symbol(symbol_with_label[m], shift.state_node);
+                m_gss.add_semantics_to_symbol(symbol_with_label[m], value);
                 temp_symbol = symbol_with_label[m];
                 break;
               }
             if(found_state_node)
               break;
           }
-          if(found_state_node == false)
-          {
-            for(m = 0; m < symbol_with_label.size(); m++)
-            {
-              successors_of_symbol = m_gss.get_symbol_successors(symbol_with_label[m]);
-              for(l = 0; l < successors_of_symbol.size(); l++)
-                if(m_gss.get_state_level(successors_of_symbol[l]) == m_gss.get_state_level(q_iter->state_node))
-                {
-                  found_state_node = true;
-                 // m_gss.add_successor_to_state(state_with_label[k], symbol_with_label[m]);
-                  m_gss.add_successor_to_symbol(symbol_with_label[m], q_iter->state_node);
-                  m_gss.add_semantics_to_symbol(symbol_with_label[m], helper);
-                  temp_symbol = symbol_with_label[m];
-                  break;
-                }
-              if(found_state_node)
-                break;
-            }
-          }
-        }
-        if(found_state_node == false)
-        {
-          temp_symbol = m_gss.create_symbol(a_i_plus_1, helper);
-          m_gss.add_successor_to_state(state_with_label[k], temp_symbol);
-          m_gss.add_successor_to_symbol(temp_symbol, q_iter->state_node);
         }
       }
-      
-      
-      for(actions = m_table->get_actions(q_iter->new_state, -a_i_plus_2).begin();
-          actions != m_table->get_actions(q_iter->new_state, -a_i_plus_2).end();
-          actions++)
+      if(found_state_node == false)
       {
-        if(actions->what == LalrTable::action::reduce && actions->reduce_length > 0)
-          m_r.insert(RMember(q_iter->state_node, actions->reduce_by, actions->reduce_length, temp_symbol));
+        temp_symbol = create_symbol(label, value);
+        m_gss.add_successor_to_state(state_with_label[k], temp_symbol);
+        m_gss.add_successor_to_symbol(temp_symbol, shift.state_node);
       }
-
     }
-    else
-    {
-      temp_state = m_gss.create_state(i + 1, q_iter->new_state);
-      temp_symbol = m_gss.create_symbol(a_i_plus_1, helper);
-      m_gss.add_successor_to_state(temp_state, temp_symbol);
-      m_gss.add_successor_to_symbol(temp_symbol, q_iter->state_node);
-      
-      for(actions = m_table->get_actions(q_iter->new_state, -a_i_plus_2).begin();
-        actions != m_table->get_actions(q_iter->new_state, -a_i_plus_2).end();
-        actions++)
-      {
-        if(actions->what == LalrTable::action::shift)
-          temp_q.insert(QMember(temp_state, actions->next_state));
-        else if(actions->reduce_length == 0)
-          m_r.insert(RMember(temp_state, actions->reduce_by, 0, temp_symbol));
 
-        if(actions->what == LalrTable::action::reduce && actions->reduce_length > 0)
-          m_r.insert(RMember(q_iter->state_node, actions->reduce_by, actions->reduce_length, temp_symbol));
-      }
-    }
+    queue_actions(state_with_label[0], shift.new_state, level, temp_symbol, &shift.state_node,
+      false, next_q);
   }
+  else
+  {
+    temp_state = create_state(level, shift.new_state);
+    temp_symbol = create_symbol(label, value);
+    m_gss.add_successor_to_state(temp_state, temp_symbol);
+    m_gss.add_successor_to_symbol(temp_symbol, shift.state_node);
 
-  m_q = temp_q;
+    queue_actions(temp_state, shift.new_state, level, temp_symbol, &shift.state_node, true, next_q);
+  }
 }
 
-void Parser::reducer(unsigned i, int a_i_plus_1)
+void Parser::reducer(unsigned i)
 {
-  std::set<LalrTable::action>::const_iterator actions;
-
   RMember* now_processed;
-  std::vector<std::pair<GSS::StateIdent, std::string > > chi;
+  std::vector<std::pair<GSS::StateIdent, GSS::ValueIdent> >& chi = m_reduce_targets;
   int state_to_go;
-  unsigned k, l;
+  unsigned k, l, m;
   
-  std::string reduce_string;
+  GSS::ValueIdent reduce_string;
   
   bool successor_added;
   
@@ -229,6 +1340,14 @@ void Parser::reducer(unsigned i, int a_i_plus_1)
   now_processed = new RMember(*m_r.begin());
   m_r.erase(*now_processed);
 
+  if(m_reductions_by_length.size() <= static_cast<unsigned>(now_processed->reduction_length))
+    m_reductions_by_length.resize(now_processed->reduction_length + 1);
+  m_reductions_by_length[now_processed->reduction_length]++;
+  m_recorder.record(BnfEvent::Event_Reduce, i, m_gss.get_state_label(now_processed->state_node),
+    now_processed->rule_number, now_processed->state_node.id, now_processed->state_node.level,
+    now_processed->reduction_length);
+  unsigned long path_steps = m_path_steps;
+
   logTrace(LOG_DEBUG, "(" << i << ") reduce by " << now_processed->rule_number
     << ", length is " << now_processed->reduction_length);
   logTrace(LOG_DEBUG, "  state: " << m_gss.get_state_label(now_processed->state_node)
@@ -243,78 +1362,81 @@ void Parser::reducer(unsigned i, int a_i_plus_1)
 ////////////////////////////////////////////////////////////////////////////////
 //HERE the find_reachable function is rewritten, so that it sees the grammar
 ////////////////////////////////////////////////////////////////////////////////
-  bool now_states = true;
   unsigned length = now_processed->reduction_length;
   
-  std::set<std::pair<GSS::SymbolIdent, std::string> > symbols;
-  std::set<std::pair<GSS::StateIdent, std::string> > states;
-  
-  std::set<std::pair<GSS::SymbolIdent, std::string> >::iterator symbols_iter;
-  std::set<std::pair<GSS::StateIdent, std::string> >::iterator states_iter;
-  
-  std::string initial_value;
-
-   if(length > 0)
-    initial_value = m_gss.get_semantic_string(now_processed->first_part);
-
-  if(length > 0 && m_table->symbol_is_marked(now_processed->rule_number, length - 1))
-    initial_value = "<" + m_grammar.get_marked_name(m_table->get_symbol(now_processed->rule_number, length - 1)) + ">"
-     + initial_value 
-     + "</" + m_grammar.get_marked_name(m_table->get_symbol(now_processed->rule_number, length - 1)) + ">"; 
+  // the distinct values of the paths ending in each state node
+  std::map<GSS::StateIdent, std::vector<GSS::ValueIdent> > states;
+  std::map<GSS::StateIdent, std::vector<GSS::ValueIdent> >::iterator states_iter;
   
-  for(k = now_processed->reduction_length; k < m_table->get_rule_length(now_processed->rule_number); k++)
-    if(m_table->symbol_is_marked(now_processed->rule_number, k))
-      initial_value = initial_value + "<" + m_grammar.get_marked_name(m_table->get_symbol(now_processed->rule_number, k))+">"
-                    +  "</"+ m_grammar.get_marked_name(m_table->get_symbol(now_processed->rule_number, k))+">";
+  const RuleMarkup& markup = (*m_parse_markup)[now_processed->rule_number];
+  std::vector<GSS::ValueIdent>& initial_value = m_reduce_initial;
+  std::vector<GSS::ValueIdent>& children = m_reduce_children;
+  chi.clear();
 
-  if(length > 0)
+  if(length > 0 && !markup.has_markup)
   {
-    states.insert(std::make_pair(now_processed->state_node, initial_value));
-    length = 2*(length - 1);
+    // the rule derives no mark, each end node gets the empty value once
+    const std::vector<Path>& paths = find_paths(now_processed->state_node, length - 1);
+    for(std::vector<Path>::const_iterator path = paths.begin(); path != paths.end(); path++)
+      chi.push_back(std::make_pair(path->end, GSS::no_markup));
+
+    std::sort(chi.begin(), chi.end());
+    chi.erase(std::unique(chi.begin(), chi.end()), chi.end());
   }
-  else
-    states.insert(std::make_pair(now_processed->state_node, ""));
-    
-    
-    
-  while(length > 0)
-  {
-    if(now_states)
-    {
-      symbols.clear();
-      for(states_iter = states.begin(); states_iter != states.end(); states_iter++)
-        for(k = 0;
-            k < m_gss.get_state_successors(states_iter->first).size();
-            k++)
-          symbols.insert(std::make_pair(m_gss.get_state_successors(states_iter->first)[k],
-                            states_iter->second));
-    }
-    else
+  else if(length > 0)
+  {
+    initial_value.clear();
+    unsigned last_begin = m_gss.get_successor_level(now_processed->first_part);
+    append_semantics(markup.marks[length - 1], now_processed->first_part, last_begin, i, initial_value);
+    for(m = 0; m < markup.nulled_suffix[length].size(); m++)
+      initial_value.push_back(m_gss.create_mark(markup.nulled_suffix[length][m], i, i, GSS::no_markup));
+
+    const std::vector<Path>& paths = find_paths(now_processed->state_node, length - 1);
+    unsigned limit = m_gss.get_max_values();
+
+    // the semantic values are built for the paths found only
+    for(std::vector<Path>::const_iterator path = paths.begin(); path != paths.end(); path++)
     {
-      states.clear();
-      for(symbols_iter = symbols.begin(); symbols_iter != symbols.end(); symbols_iter++)
-        for(k = 0;
-            k < m_gss.get_symbol_successors(symbols_iter->first).size();
-            k++)
-        {
-          if(m_table->symbol_is_marked(now_processed->rule_number, length / 2))
-            states.insert(std::make_pair(m_gss.get_symbol_successors(symbols_iter->first)[k],
-                                        + "<" + m_grammar.get_marked_name(m_table->get_symbol(now_processed->rule_number, length/2))+">" 
-                                        + m_gss.get_semantic_string(symbols_iter->first)
-                                        + "</"+ m_grammar.get_marked_name(m_table->get_symbol(now_processed->rule_number, length/2))+">"
-                                        + symbols_iter->second));
-           else
-             states.insert(std::make_pair(m_gss.get_symbol_successors(symbols_iter->first)[k],
-                                        m_gss.get_semantic_string(symbols_iter->first)
-                                        + symbols_iter->second));
-        }
+      // the number of paths (semantic values) ending in one node is limited by the ambiguity policy
+      std::vector<GSS::ValueIdent>& values = states[path->end];
+      if(limit != 0 && values.size() >= limit)
+        continue;
+
+      children.clear();
+      // the farthest symbol node is the first symbol of the rule
+      for(l = 0; l < path->symbols.size(); l++)
+      {
+        const GSS::SymbolIdent& symbol = path->symbols[path->symbols.size() - 1 - l];
+        unsigned end = (l + 1 < path->symbols.size())
+          ? m_gss.get_successor_level(path->symbols[path->symbols.size() - 2 - l]) : last_begin;
+        append_semantics(markup.marks[l], symbol, m_gss.get_successor_level(symbol), end, children);
+      }
+      children.insert(children.end(), initial_value.begin(), initial_value.end());
+      GSS::ValueIdent value = m_gss.create_sequence(children);
+
+      // the number of paths may grow exponentially with the ambiguity
+      if(m_limits.max_semantic_bytes != 0)
+        check_limits();
+
+      for(m = 0; m < values.size(); m++)
+        if(m_gss.values_equal(values[m], value))
+          break;
+      if(m == values.size())
+        values.push_back(value);
     }
-    length--;
-    now_states = !now_states;
   }
+  else
+    states[now_processed->state_node].push_back(GSS::no_markup);
 
   for(states_iter = states.begin(); states_iter != states.end(); states_iter++)
-    chi.push_back(std::make_pair(states_iter->first, states_iter->second));
+    for(m = 0; m < states_iter->second.size(); m++)
+      chi.push_back(std::make_pair(states_iter->first, states_iter->second[m]));
+
+  if(m_profiling)
+  {
+    m_rule_reductions[now_processed->rule_number]++;
+    m_rule_path_steps[now_processed->rule_number] += m_path_steps - path_steps;
+  }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -324,49 +1446,30 @@ void Parser::reducer(unsigned i, int a_i_plus_1)
   {
     new_semantics = true;
     reduce_string = chi[k].second;
-    state_to_go = m_table->get_go_to(m_gss.get_state_label(chi[k].first), 
-                                     m_table->get_lhs(now_processed->rule_number) + 256);
+    state_to_go = m_parse_table->get_go_to(m_gss.get_state_label(chi[k].first), 
+                                     m_parse_table->get_symbol_index(m_parse_table->get_lhs(now_processed->rule_number)));
 
     logTrace(LOG_DEBUG, "label chi[k]: " << m_gss.get_state_label(chi[k].first));
     logTrace(LOG_DEBUG, "level chi[k]: " << m_gss.get_state_level(chi[k].first));
-    logTrace(LOG_DEBUG, "LHS           " << m_table->get_lhs(now_processed->rule_number));
+    logTrace(LOG_DEBUG, "LHS           " << m_parse_table->get_lhs(now_processed->rule_number));
     logTrace(LOG_DEBUG, "GOTO          " << state_to_go);
          
     state_with_label = m_gss.find_state(i, state_to_go);
     if(state_with_label.empty())
     {
-      temp_state = m_gss.create_state(i, state_to_go);
-      temp_symbol = m_gss.create_symbol(m_table->get_lhs(now_processed->rule_number), reduce_string);
+      temp_state = create_state(i, state_to_go);
+      temp_symbol = create_symbol(m_parse_table->get_lhs(now_processed->rule_number), reduce_string,
+        now_processed->rule_number);
       
       m_gss.add_successor_to_state(temp_state, temp_symbol);
       m_gss.add_successor_to_symbol(temp_symbol, chi[k].first);
-      for(actions = m_table->get_actions(state_to_go, -a_i_plus_1).begin();
-          actions != m_table->get_actions(state_to_go, -a_i_plus_1).end();
-          actions++)
-      {
-        if(actions->what == LalrTable::action::shift)
-        {
-          m_q.insert(QMember(temp_state, actions->next_state));
-        }
-        else if(actions->reduce_length == 0)
-          m_r.insert(RMember(temp_state, actions->reduce_by, 0, temp_symbol));
-      }
-    
-      if(now_processed->reduction_length != 0)
-        for(actions = m_table->get_actions(state_to_go, -a_i_plus_1).begin();
-            actions != m_table->get_actions(state_to_go, -a_i_plus_1).end();
-            actions++)
-        {
-          if(actions->what == LalrTable::action::reduce && actions->reduce_length > 0)
-          {
-            m_r.insert(RMember(chi[k].first, actions->reduce_by, actions->reduce_length, temp_symbol));
-          }
-        }
+      queue_actions(temp_state, state_to_go, i, temp_symbol,
+        (now_processed->reduction_length != 0) ? &chi[k].first : NULL, true, m_q);
     }
     else
     {
       symbol_with_label = m_gss.get_state_successors_with_label(state_with_label[0],
-                                 m_table->get_lhs(now_processed->rule_number));
+                                 m_parse_table->get_lhs(now_processed->rule_number));
 
       successor_added = false;
       for(l = 0; l < symbol_with_label.size(); l++)
@@ -374,10 +1477,10 @@ void Parser::reducer(unsigned i, int a_i_plus_1)
         if(m_gss.has_state_successor(symbol_with_label[l], chi[k].first))
         {
           successor_added = true;
-          if(m_gss.symbol_has_semantics(symbol_with_label[l], reduce_string))
-            new_semantics = false;
-          else
-            m_gss.add_semantics_to_symbol(symbol_with_label[l], reduce_string);
+          m_gss.mark_ambiguous(symbol_with_label[l]);
+          // the values rejected by the ambiguity policy are not propagated further
+          new_semantics = m_gss.add_semantics_to_symbol(symbol_with_label[l], reduce_string,
+            now_processed->rule_number);
           temp_symbol = symbol_with_label[l];
           break;
         }
@@ -389,7 +1492,8 @@ void Parser::reducer(unsigned i, int a_i_plus_1)
           if(m_gss.get_state_level(m_gss.get_symbol_successors(symbol_with_label[l])[0]) == m_gss.get_state_level(chi[k].first))
           {
             successor_added = true;
-            m_gss.add_semantics_to_symbol(symbol_with_label[l], reduce_string);
+            m_gss.add_semantics_to_symbol(symbol_with_label[l], reduce_string,
+              now_processed->rule_number);
             m_gss.add_successor_to_symbol(symbol_with_label[l], chi[k].first);
             temp_symbol = symbol_with_label[l];
             break;
@@ -398,27 +1502,352 @@ void Parser::reducer(unsigned i, int a_i_plus_1)
       }
       if(!successor_added)
       {
-        temp_symbol = m_gss.create_symbol(m_table->get_lhs(now_processed->rule_number), reduce_string);
+        temp_symbol = create_symbol(m_parse_table->get_lhs(now_processed->rule_number), reduce_string,
+        now_processed->rule_number);
         m_gss.add_successor_to_state(state_with_label[0], temp_symbol);
         m_gss.add_successor_to_symbol(temp_symbol, chi[k].first);
       }
         
       if(now_processed->reduction_length != 0 && new_semantics)
-        for(actions = m_table->get_actions(state_to_go, -a_i_plus_1).begin();
-            actions != m_table->get_actions(state_to_go, -a_i_plus_1).end();
-            actions++)
+        queue_actions(state_with_label[0], state_to_go, i, temp_symbol, &chi[k].first, false, m_q);
+    }
+  }
+  delete now_processed;
+}
+
+const std::vector<Parser::Path>& Parser::find_paths(const GSS::StateIdent& start, unsigned length)
+{
+  std::pair<GSS::StateIdent, unsigned> key(start, length);
+  std::map<std::pair<GSS::StateIdent, unsigned>, PathMemo>::iterator pos = m_paths.find(key);
+  if(pos != m_paths.end()
+    && (pos->second.complete || pos->second.edge_count == m_gss.get_edge_count()))
+    return pos->second.paths;
+
+  std::vector<Path> paths;
+  if(length == 0)
+    paths.push_back(Path(start));
+  else
+  {
+    // the paths are extensions of the shorter paths, which are memoized too
+    const std::vector<Path>& shorter = find_paths(start, length - 1);
+    std::map<GSS::StateIdent, unsigned> path_count;
+    unsigned limit = m_gss.get_max_values();
+
+    for(std::vector<Path>::const_iterator path = shorter.begin(); path != shorter.end(); path++)
+    {
+      const std::vector<GSS::SymbolIdent>& symbols = m_gss.get_state_successors(path->end);
+      for(unsigned k = 0; k < symbols.size(); k++)
+      {
+        const std::vector<GSS::StateIdent>& ends = m_gss.get_symbol_successors(symbols[k]);
+        for(unsigned l = 0; l < ends.size(); l++)
         {
-          if(actions->what == LalrTable::action::reduce && actions->reduce_length > 0)
-            m_r.insert(RMember(chi[k].first, actions->reduce_by, actions->reduce_length, temp_symbol));
+          // the ambiguity policy limits the paths ending in one node
+          if(limit != 0 && ++path_count[ends[l]] > limit)
+            continue;
+
+          paths.push_back(Path(ends[l]));
+          paths.back().symbols = path->symbols;
+          m_path_steps++;
+          paths.back().symbols.push_back(symbols[k]);
         }
+      }
+    }
+    check_limits();
+  }
+
+  PathMemo& memo = m_paths[key];
+  memo.paths.swap(paths);
+  memo.edge_count = m_gss.get_edge_count();
+  memo.complete = m_gss.get_state_level(start) < m_current_level;
+  return memo.paths;
+}
+
+void Parser::compute_markup(void)
+{
+  unsigned rule, k;
+  std::map<int, int> mark_numbers;
+  m_markup.assign(m_table->get_rule_count(), RuleMarkup());
+  m_mark_names = m_field_names;
+
+  for(rule = 0; rule < m_markup.size(); rule++)
+  {
+    RuleMarkup& markup = m_markup[rule];
+    size_t length = m_table->get_rule_length(rule);
+
+    markup.marks.assign(length, -1);
+    for(k = 0; k < length; k++)
+    {
+      if(m_table->symbol_is_marked(rule, k))
+      {
+        int symbol = m_table->get_symbol(rule, k);
+        std::map<int, int>::iterator pos = mark_numbers.find(symbol);
+        if(pos == mark_numbers.end())
+        {
+          std::string name = m_grammar.get_marked_name(symbol);
+          int number = std::find(m_mark_names.begin(), m_mark_names.end(), name) - m_mark_names.begin();
+          if(m_field_names.empty())
+            m_mark_names.push_back(name);
+          // the marks not requested are ignored
+          else if(number == static_cast<int>(m_mark_names.size()))
+            number = -1;
+          pos = mark_numbers.insert(std::make_pair(symbol, number)).first;
+        }
+        markup.marks[k] = pos->second;
+      }
+    }
+
+    // a nulled symbol contributes its tags only
+    markup.nulled_suffix.resize(length + 1);
+    for(k = length; k > 0; k--)
+    {
+      markup.nulled_suffix[k - 1] = markup.nulled_suffix[k];
+      if(markup.marks[k - 1] != -1)
+        markup.nulled_suffix[k - 1].insert(markup.nulled_suffix[k - 1].begin(), markup.marks[k - 1]);
+    }
+  }
+
+  // the nonterminals deriving a mark
+  std::set<int> marked;
+  bool changed = true;
+  while(changed)
+  {
+    changed = false;
+    for(rule = 0; rule < m_markup.size(); rule++)
+    {
+      RuleMarkup& markup = m_markup[rule];
+      for(k = 0; k < markup.marks.size() && !markup.has_markup; k++)
+        if(markup.marks[k] != -1 || marked.count(m_table->get_symbol(rule, k)))
+          markup.has_markup = true;
+
+      if(markup.has_markup && marked.insert(m_table->get_lhs(rule)).second)
+        changed = true;
+    }
+  }
+
+  std::vector<bool> found(m_field_names.size(), false);
+  for(std::map<int, int>::const_iterator pos = mark_numbers.begin(); pos != mark_numbers.end(); pos++)
+    if(pos->second != -1 && !m_field_names.empty())
+      found[pos->second] = true;
+
+  for(k = 0; k < m_field_names.size(); k++)
+    if(!found[k])
+    {
+      BnfReport report(m_interface->get_reporter(), BnfReporter::ErrorType_Warning);
+      report.text()
+        << "Field \"" << m_field_names[k] << "\" is not a marked nonterminal.";
+    }
+}
+
+void Parser::append_semantics(int mark, const GSS::SymbolIdent& symbol, unsigned begin, unsigned end,
+  std::vector<GSS::ValueIdent>& values)
+{
+  GSS::ValueIdent value = m_gss.get_value(symbol, begin, end);
+  if(mark != -1)
+    value = m_gss.create_mark(mark, begin, end, value);
+  if(value != GSS::no_markup)
+    values.push_back(value);
+}
+
+size_t Parser::write_markup(size_t k, unsigned& position, std::string& out) const
+{
+  for(; k < m_semantics.size(); k++)
+  {
+    const GSS::MarkupEvent& event = m_semantics[k];
+    if(event.type == GSS::MarkupEvent::Event_AlternativeEnd)
+      break;
+
+    out.append(m_accepted_data + position, event.offset - position);
+    position = event.offset;
+
+    switch(event.type)
+    {
+    case GSS::MarkupEvent::Event_Enter:
+      out += "<" + (*m_parse_mark_names)[event.mark] + ">";
+      break;
+    case GSS::MarkupEvent::Event_Leave:
+      out += "</" + (*m_parse_mark_names)[event.mark] + ">";
+      break;
+    case GSS::MarkupEvent::Event_AmbiguityBegin:
+    {
+      // the alternatives are listed in the order of their strings
+      std::set<std::string> ways;
+      for(k++; m_semantics[k].type == GSS::MarkupEvent::Event_AlternativeBegin; k++)
+      {
+        std::string way;
+        unsigned way_position = m_semantics[k].offset;
+        k = write_markup(k + 1, way_position, way);
+        way.append(m_accepted_data + way_position, m_semantics[k].offset - way_position);
+        ways.insert(way);
+      }
+
+      if(ways.size() == 1)
+        out += *ways.begin();
+      else
+      {
+        out += "<ambiguity>";
+        for(std::set<std::string>::const_iterator way = ways.begin(); way != ways.end(); way++)
+          out += "<way>" + *way + "</way>";
+        out += "</ambiguity>";
+      }
+      position = m_semantics[k].offset;
+      break;
+    }
+    }
+  }
+  return k;
+}
+
+std::string Parser::get_semantic_string(void)
+{
+  std::string result;
+  unsigned position = 0;
+
+  if(m_accepted_data == NULL)
+    return result;
+
+  m_semantics.clear();
+  m_gss.get_semantics(m_accepted_value, m_semantics);
+
+  write_markup(0, position, result);
+  result.append(m_accepted_data + position, m_match_length - position);
+  return result;
+}
+
+void Parser::visit_semantics(BnfVisitor& visitor)
+{
+  m_semantics.clear();
+  m_gss.get_semantics(m_accepted_value, m_semantics);
+
+  for(size_t k = 0; k < m_semantics.size(); k++)
+  {
+    const GSS::MarkupEvent& event = m_semantics[k];
+    switch(event.type)
+    {
+    case GSS::MarkupEvent::Event_Enter:
+      visitor.enter((*m_parse_mark_names)[event.mark], event.offset);
+      break;
+    case GSS::MarkupEvent::Event_Leave:
+      visitor.leave((*m_parse_mark_names)[event.mark], event.offset);
+      break;
+    case GSS::MarkupEvent::Event_AmbiguityBegin:
+      visitor.ambiguity(BnfVisitor::Ambiguity_Begin, event.offset);
+      break;
+    case GSS::MarkupEvent::Event_AlternativeBegin:
+      visitor.ambiguity(BnfVisitor::Ambiguity_Alternative, event.offset);
+      break;
+    case GSS::MarkupEvent::Event_AmbiguityEnd:
+      visitor.ambiguity(BnfVisitor::Ambiguity_End, event.offset);
+      break;
+    }
+  }
+}
+
+unsigned Parser::add_field(const std::string& name)
+{
+  // the name may be given as in the grammar, e.g. callid@
+  std::string field = name;
+  if(!field.empty() && field[field.size() - 1] == '@')
+    field.erase(field.size() - 1);
+
+  std::vector<std::string>::iterator pos = std::find(m_field_names.begin(), m_field_names.end(), field);
+  if(pos != m_field_names.end())
+    return pos - m_field_names.begin();
+
+  m_field_names.push_back(field);
+  return m_field_names.size() - 1;
+}
+
+const std::string& Parser::get_field_name(unsigned field) const
+{
+  if(m_parse_mark_names != NULL)
+    return m_parse_mark_names->at(field);
+
+  // nothing parsed yet, the fields requested are numbered by add_field()
+  if(!m_field_names.empty())
+    return m_field_names.at(field);
+  const Parser *source = (m_source != NULL) ? m_source : this;
+  return source->m_mark_names.at(field);
+}
+
+void Parser::get_fields(std::vector<BnfField>& fields)
+{
+  fields.clear();
+  m_open_fields.clear();
+  m_semantics.clear();
+  m_gss.get_semantics(m_accepted_value, m_semantics, true);
+
+  for(size_t k = 0; k < m_semantics.size(); k++)
+  {
+    const GSS::MarkupEvent& event = m_semantics[k];
+    if(event.type == GSS::MarkupEvent::Event_Enter)
+    {
+      m_open_fields.push_back(fields.size());
+      fields.push_back(BnfField());
+      fields.back().field = event.mark;
+      fields.back().begin = event.offset;
+    }
+    else if(event.type == GSS::MarkupEvent::Event_Leave)
+    {
+      fields[m_open_fields.back()].end = event.offset;
+      m_open_fields.pop_back();
+    }
+  }
+}
+
+void Parser::compute_lookahead(void)
+{
+  unsigned state, byte, k;
+  m_lookahead.assign(m_table->get_state_count(), std::bitset<256>());
+
+  // the rule 0 derives the start symbol, or the choice of several start symbols
+  int start = m_table->get_symbol(0, 0);
+  m_start_token = m_tokenizer.get_column(start);
+
+  m_start_names.clear();
+  m_start_states.clear();
+  if(m_grammar.get_start_symbols().size() == 1)
+  {
+    m_start_names.push_back(m_grammar.get_start_symbols()[0].first);
+    m_start_states.push_back(m_table->get_accepting_state());
+  }
+  else
+  {
+    // the alternatives of the choice, each derives one start symbol
+    for(unsigned rule = 1; rule < m_table->get_rule_count(); rule++)
+      if(m_table->get_lhs(rule) == start)
+      {
+        int symbol = m_table->get_symbol(rule, 0);
+        m_start_names.push_back(m_grammar.get_marked_name(symbol));
+        m_start_states.push_back(m_table->get_go_to(0, m_table->get_symbol_index(symbol)));
+      }
+  }
+
+  for(state = 0; state < m_lookahead.size(); state++)
+  {
+    for(byte = 0; byte < 256; byte++)
+      if(!m_table->get_actions(state, byte).empty())
+        m_lookahead[state].set(byte);
+
+    const std::vector<int>& tokens = m_table->get_token_columns(state);
+    for(k = 0; k < tokens.size(); k++)
+    {
+      const Tokenizer::Dfa& dfa = m_tokenizer.get_dfa(tokens[k]);
+      for(byte = 0; byte < 256; byte++)
+        if(dfa.next[dfa.classes[byte]] != -1)
+          m_lookahead[state].set(byte);
     }
   }
-  delete now_processed;
 }
 
 void Parser::process_grammar(const std::multimap<int, std::vector<int> >& grammar, unsigned nonterm_count)
 {
-  m_table = new LalrTable(nonterm_count);
+  // when grammars were added after the parser was built, only the part
+  // of the table affected by the new rules is computed again
+  if(m_table != NULL && m_table->update(grammar, nonterm_count, m_tokenizer.get_token_count()))
+    return;
+
+  delete m_table;
+  m_table = new LalrTable(nonterm_count, m_tokenizer.get_token_count());
   m_table->load(grammar);
   m_table->make_lalr_table();
 }
@@ -25,11 +25,16 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <bitset>
 
 #include "BnfParser2.h"
 #include "AnyBnfLoad.h"
 #include "GSS.h"
 #include "LalrTable.h"
+#include "GrammarCache.h"
+#include "Tokenizer.h"
+#include "Prefilter.h"
+#include "EventRecorder.h"
 
 
 /** \brief This class contains the implementation of the parser proper.
@@ -95,6 +100,27 @@ public:
    */
   bool parse_word(const std::string& word);
 
+  //! Parses the word in the caller's buffer, see BnfParser2::parse()
+  bool parse(const char *word, size_t length);
+
+  //! Parses the document of an editing session, see BnfParser2::parse_document()
+  bool parse_document(const std::string& document);
+
+  //! Edits the document and parses it again, see BnfParser2::reparse()
+  bool reparse(size_t offset, size_t removed_length, const char *inserted, size_t inserted_length);
+
+  //! Returns the document of the editing session
+  const std::string& get_document(void) const
+  {
+    return m_document;
+  }
+
+  //! Finds the parts of the buffer the start symbol generates, see BnfParser2::search()
+  bool search(const char *buffer, size_t length, std::vector<BnfParser2::Match>& matches);
+
+  //! Parses many words, see BnfParser2::parse_words()
+  void parse_words(const std::vector<std::string>& words, std::vector<BnfParser2::WordResult>& results);
+
   //! Adds new path where grammar and syntax specifications are located
   void add_search_path(const char *path)
   {
@@ -107,35 +133,176 @@ public:
     m_grammar.set_start_symbol(symbol_name,start_grammar_name);
   }
 
-  //! Calls for add_grammar() for unresolved references
-  void add_referenced_grammars()
+  //! Adds another starting nonterminal, see BnfParser2::add_start_symbol()
+  void add_start_symbol(const char *symbol_name, const char *start_grammar_name = NULL)
+  {
+    m_grammar.add_start_symbol(symbol_name,start_grammar_name);
+  }
+
+  //! Sets the start symbol the word must match, an empty name for any
+  void set_target_symbol(const std::string& symbol_name)
   {
-    m_grammar.add_referenced_grammars();
+    m_target_symbol = symbol_name;
   }
 
+  //! Adds a nonterminal to recover on, see BnfParser2::add_recovery_symbol()
+  void add_recovery_symbol(const std::string& symbol_name, const std::string& terminator)
+  {
+    m_recovery_symbols.push_back(RecoverySymbol());
+    m_recovery_symbols.back().name = symbol_name;
+    m_recovery_symbols.back().terminator = terminator;
+  }
+
+  //! Returns the syntax errors of the last parsing, see BnfParser2::get_errors()
+  const std::vector<BnfParser2::ErrorSpan>& get_errors(void) const
+  {
+    return m_errors;
+  }
+
+  //! Returns the start symbols that generate the word accepted by the last parsing
+  const std::vector<std::string>& get_matched_symbols(void) const
+  {
+    return m_matched_symbols;
+  }
+
+  //! Calls for add_grammar() for unresolved references
+  void add_referenced_grammars();
+
   //! Loads a grammar-file together with its configuration file (mutliple calls possible)
-  void add_grammar(const char *grammar_name, const char *syntax_name = NULL)
+  /** When the cache is enabled, the file is only located and its processing
+   *  is postponed to build_parser().
+   */
+  void add_grammar(const char *grammar_name, const char *syntax_name = NULL);
+
+  //! Sets the directory of the compiled grammar cache. Must be called before add_grammar().
+  void set_cache_directory(const char *path)
   {
-    m_grammar.add_grammar(grammar_name, syntax_name);
+    m_cache.set_directory(path ? path : "");
   }
 
-  //! Processes the set of grammar files added, computes GLALR table.
-  void build_parser(void)
+  //! Enables or disables the tokens, see Tokenizer
+  void set_token_extraction(bool enabled)
   {
-    m_grammar.remove_unreachable();
-    process_grammar(m_grammar.get_grammar(), m_grammar.get_nonterm_count());
+    m_tokenizer.set_enabled(enabled);
   }
 
+  //! Parses using the table and the names of another parser, NULL to use own
+  /** The other parser is not modified by the parsing, so it may be shared.
+   */
+  void use_grammar_of(const Parser *source)
+  {
+    // the other parser may be deleted once it is not used
+    if(source != m_source)
+    {
+      m_kept_source = NULL;
+      m_profile_source = NULL;
+    }
+    m_source = source;
+  }
+
+  //! Processes the set of grammar files added, computes GLALR table.
+  /** When the cache is enabled and it contains the table, the grammar files
+   *  are not processed at all.
+   */
+  void build_parser(void);
+
   Parser(BnfParser2 *interface)
-  : m_interface(interface), m_grammar(interface)
+  : m_interface(interface), m_last_accepted(false), m_error_position(0),
+    m_accepted_value(GSS::no_markup), m_accepted_data(NULL),
+    m_result_code(BnfParser2::Result_Rejected), m_prefilter_enabled(false),
+    m_match_mode(BnfParser2::Match_Whole), m_match_length(0),
+    m_reduction_count(0), m_shift_count(0), m_path_steps(0),
+    m_profiling(false), m_profile_source(NULL), m_profile_version(0),
+    m_start_time(0), m_current_level(0),
+    m_table(NULL), m_table_version(0), m_source(NULL), m_parse_table(NULL), m_parse_markup(NULL),
+    m_parse_mark_names(NULL),
+    m_parse_tokens(NULL), m_parse_lookahead(NULL), m_start_token(-1), m_word(NULL), m_word_length(0),
+    m_token_reach(0),
+    m_prefix_ends(false), m_reduce_all(false),
+    m_keep_levels(false), m_edit_position(0), m_kept_source(NULL), m_kept_version(0), m_kept_target(-1),
+    m_max_token_span(0), m_read_reach(0),
+    m_grammar(interface), m_cache(interface),
+    m_pending_references(false), m_pending_loaded(0)
   {}
 
+  ~Parser()
+  {
+    delete m_table;
+  }
+
   //! Returns the result of the last parsing.
   bool get_parsing_result(void)
   {
     return m_last_accepted;
   }
 
+  //! Sets the limits checked by parse_word()
+  void set_limits(const BnfLimits& limits)
+  {
+    m_limits = limits;
+  }
+
+  //! Enables or disables the prefilter, see BnfParser2::set_prefilter()
+  void set_prefilter(bool enabled)
+  {
+    m_prefilter_enabled = enabled;
+  }
+
+  //! Sets the part of the word accepted, see BnfParser2::set_match_mode()
+  void set_match_mode(BnfParser2::MatchMode mode)
+  {
+    m_match_mode = mode;
+  }
+
+  //! Returns the length of the prefix accepted by the last parsing
+  unsigned get_match_length(void)
+  {
+    return m_match_length;
+  }
+
+  //! Sets how many derivations of the ambiguous parts are kept
+  void set_ambiguity_policy(BnfParser2::AmbiguityPolicy policy, unsigned max_ways)
+  {
+    switch(policy)
+    {
+    case BnfParser2::Ambiguity_KeepAll:
+      m_gss.set_ambiguity_policy(0, false);
+      break;
+    case BnfParser2::Ambiguity_KeepFirst:
+      m_gss.set_ambiguity_policy(1, false);
+      break;
+    case BnfParser2::Ambiguity_KeepN:
+      m_gss.set_ambiguity_policy(max_ways, false);
+      break;
+    case BnfParser2::Ambiguity_PreferRule:
+      m_gss.set_ambiguity_policy(1, true);
+      break;
+    }
+    // the levels kept were built with another policy
+    m_kept_source = NULL;
+  }
+
+  //! Returns the result of the last parsing in detail.
+  BnfParser2::ResultCode get_result_code(void)
+  {
+    return m_result_code;
+  }
+
+  //! Returns the statistics of the last parsing, see BnfParser2::get_parse_stats()
+  void get_parse_stats(BnfParseStats& stats) const;
+
+  //! Enables or disables the profiling, see BnfParser2::set_profiling()
+  void set_profiling(bool enabled);
+
+  //! Returns the work counted by the profiling, see BnfParser2::get_profile()
+  void get_profile(BnfProfile& profile) const;
+
+  //! Returns the recorder of the events of the parsings, see BnfParser2::set_event_recording()
+  EventRecorder& get_recorder(void)
+  {
+    return m_recorder;
+  }
+
   //! Returns the position of an error occuring during the last parsing.
   /** When the last parsing is successful, the return value is not defined.
    */
@@ -146,11 +313,21 @@ public:
 
   //! Returns the semantic string of the last parsing
   /** When the last parsing is unsuccessful, the return value is not defined.
+   *  The string is built from the markup of the accepted derivations.
    */
-  std::string get_semantic_string(void)
-  {
-    return m_semantic_string;
-  }
+  std::string get_semantic_string(void);
+
+  //! Reports the markup of the last parsing to the visitor, see BnfParser2::visit_semantics()
+  void visit_semantics(BnfVisitor& visitor);
+
+  //! Requests a marked nonterminal, see BnfParser2::add_field()
+  unsigned add_field(const std::string& name);
+
+  //! Returns the requested fields of the last parsing, see BnfParser2::get_fields()
+  void get_fields(std::vector<BnfField>& fields);
+
+  //! Returns the name of the field number, see BnfParser2::get_field_name()
+  const std::string& get_field_name(unsigned field) const;
 
 private:
   BnfParser2 *m_interface;
@@ -161,37 +338,536 @@ private:
   //! Stores the position of an error occuring during the last parsing.
    unsigned m_error_position;
 
-  //! Stores the semantic string of the last parsing.
-   std::string m_semantic_string;
+  //! Stores the semantic value of the derivations accepted by the last parsing.
+   GSS::ValueIdent m_accepted_value;
+
+  //! The markup events of #m_accepted_value, filled when the markup is requested.
+   GSS::Semantics m_semantics;
+
+  //! Stores the input accepted by the last parse_word(), which may not outlive the call
+   std::string m_accepted_word;
+
+  //! The input accepted by the last parsing, the markup refers to it.
+   const char *m_accepted_data;
+
+  //! The fields of get_fields() not ended yet, kept to reuse its memory
+   std::vector<size_t> m_open_fields;
+
+  //! Stores the result code of the last parsing.
+   BnfParser2::ResultCode m_result_code;
+
+  //! The limits of the resources used by one parsing
+  BnfLimits m_limits;
+
+  //! If set, the words failing the prefilter of the grammar are rejected without parsing
+  bool m_prefilter_enabled;
+
+  //! The part of the word accepted by parse_word()
+  BnfParser2::MatchMode m_match_mode;
+
+  //! The length of the prefix accepted by the last parsing
+  unsigned m_match_length;
+
+  //! The start symbol the word must match, empty for any
+  std::string m_target_symbol;
+
+  //! A nonterminal the parsing recovers on, see BnfParser2::add_recovery_symbol()
+  class RecoverySymbol
+  {
+  public:
+    //! The name of the nonterminal
+    std::string name;
+
+    //! The string every word of the nonterminal ends with
+    std::string terminator;
+
+    //! The numbers of the nonterminal in #m_table, one for each grammar defining it
+    std::vector<int> symbols;
+  };
+
+  //! The nonterminals the parsing recovers on
+  std::vector<RecoverySymbol> m_recovery_symbols;
+
+  //! Finds the #m_recovery_symbols in #m_table
+  void compute_recovery(void);
+
+  //! The syntax errors of the last parsing
+  std::vector<BnfParser2::ErrorSpan> m_errors;
+
+  //! Skips the erroneous recovery symbol the parsing stopped in
+  /** The symbol is shifted as a token ending after its terminator, so the
+   *  parsing continues there. Returns false if no recovery symbol may
+   *  contain the error position.
+   */
+  bool recover(const Parser *source, unsigned level, size_t position);
+
+  //! Records the error the parsing stopped at and rejects the word
+  bool reject(size_t position);
+
+  //! The start symbols that generate the word accepted by the last parsing
+  std::vector<std::string> m_matched_symbols;
+
+  //! The number of reductions performed by the current parsing
+  unsigned long m_reduction_count;
+
+  //! The number of shifts performed by the current parsing
+  unsigned long m_shift_count;
+
+  //! The number of paths extended by find_paths() in the current parsing
+  unsigned long m_path_steps;
+
+  //! The number of reductions of each length performed by the current parsing
+  std::vector<unsigned long> m_reductions_by_length;
+
+  //! If set, the work is counted per rule and per state, see BnfParser2::set_profiling()
+  bool m_profiling;
+
+  //! The parser whose grammar the profile counts belong to, NULL if none were counted
+  const Parser *m_profile_source;
+
+  //! The #m_table_version of #m_profile_source the counts belong to
+  unsigned m_profile_version;
+
+  //! The reductions performed by each rule while profiling
+  std::vector<unsigned long> m_rule_reductions;
+
+  //! The path steps of the reductions by each rule while profiling
+  /** A memoized path is counted for the rule whose reduction searched it.
+   */
+  std::vector<unsigned long> m_rule_path_steps;
+
+  //! The state nodes of each state with several actions on the lookahead while profiling
+  std::vector<unsigned long> m_state_splits;
+
+  //! The last events of the parsings
+  EventRecorder m_recorder;
+
+  //! Creates a state node of the gss, records the event
+  GSS::StateIdent create_state(unsigned level, int state);
+
+  //! Creates a symbol node of the gss, records the event
+  GSS::SymbolIdent create_symbol(int symbol, GSS::ValueIdent value, int rule = -1);
+
+  //! Records the end of the parsing with the result, returns the result
+  bool record_end(bool result);
+
+  //! Starts the counters and the time of a new parsing
+  void reset_counters(void);
+
+  //! The time the current parsing started, in milliseconds
+  unsigned long m_start_time;
+
+  //! The level of the gss processed by the current parsing
+  unsigned m_current_level;
+
+  //! Thrown by check_limits() to stop the parsing
+  class LimitExceeded
+  {
+  public:
+    BnfParser2::ResultCode code;
+    LimitExceeded(BnfParser2::ResultCode _code)
+    :code(_code)
+    {}
+  };
+
+  //! Throws LimitExceeded if the current parsing exceeded any of #m_limits.
+  void check_limits(void);
+
+  //! A path in the gss walked by a reduction
+  class Path
+  {
+  public:
+    //! The state node the path ends in
+    GSS::StateIdent end;
+
+    //! The symbol nodes passed, the nearest one first
+    std::vector<GSS::SymbolIdent> symbols;
+
+    Path(const GSS::StateIdent& _end)
+    :end(_end)
+    {}
+  };
+
+  //! The paths of one length starting in one state node
+  class PathMemo
+  {
+  public:
+    std::vector<Path> paths;
+
+    //! The number of gss edges when the paths were found
+    unsigned long edge_count;
+
+    //! Set if the paths cannot change during the current parsing
+    bool complete;
+  };
+
+  //! The paths walked by the reductions of the current parsing
+  /** Indexed by the starting state node and the number of symbol nodes passed.
+   *  New edges start at the current level only, so the paths starting below
+   *  the current level cannot change. The other paths are valid until an edge
+   *  is added.
+   */
+  std::map<std::pair<GSS::StateIdent, unsigned>, PathMemo> m_paths;
+
+  //! Returns the paths passing the given number of symbol nodes
+  const std::vector<Path>& find_paths(const GSS::StateIdent& start, unsigned length);
 
   //! The set of pending shift actions
   std::set<QMember> m_q;
   
   //! The set of pending reductions
   std::set<RMember> m_r;
+
+  //! The end nodes of the current reduction and their values, kept to reuse the memory
+  std::vector<std::pair<GSS::StateIdent, GSS::ValueIdent> > m_reduce_targets;
+
+  //! The values of the symbols of the current reduction, kept to reuse the memory
+  std::vector<GSS::ValueIdent> m_reduce_children;
+
+  //! The values of the last and the nulled symbols of the current reduction
+  std::vector<GSS::ValueIdent> m_reduce_initial;
   
   //! The pointer to the GLALR table
   /** Dynamic memory is used, because the size of the table may differ.
    */
   LalrTable *m_table;
+
+  //! Changed whenever #m_table is built, also when it is updated in place
+  /** The data derived from the table of another parser are kept for the
+   *  same parser and version only. The versions are unique among all the
+   *  parsers, so a parser created at the address of a deleted one has
+   *  other versions.
+   */
+  unsigned m_table_version;
+
+  //! The parser whose grammar is used by parse_word(), NULL for this one
+  const Parser *m_source;
+
+  //! The table used by the current parsing, either #m_table or the one of #m_source
+  LalrTable *m_parse_table;
+
+  //! The markup of one rule, the semantics of the nulled symbols included
+  class RuleMarkup
+  {
+  public:
+    //! The mark of each symbol, the index to #m_mark_names or -1 if not marked
+    std::vector<int> marks;
+
+    //! The marks of the nulled suffix, indexed by the reduction length
+    /** A reduction may end before the end of the rule, when the rest of the
+     *  rule derives the empty string (right-nulled reduction). The rest is
+     *  not in the gss, its markup is precomputed here.
+     */
+    std::vector<std::vector<int> > nulled_suffix;
+
+    //! If not set, no symbol of the rule derives a mark, the values are not built
+    bool has_markup;
+
+    RuleMarkup(void)
+    : has_markup(false)
+    {}
+  };
+
+  //! The markup of the rules of #m_table
+  std::vector<RuleMarkup> m_markup;
+
+  //! The names of the marked nonterminals of #m_table
+  /** When some fields are requested, the names are those of #m_field_names
+   *  and the other marks are ignored.
+   */
+  std::vector<std::string> m_mark_names;
+
+  //! The marked nonterminals requested by add_field(), empty for all
+  std::vector<std::string> m_field_names;
+
+  //! Fills #m_markup and #m_mark_names for the rules of #m_table
+  void compute_markup(void);
+
+  //! The markup used by the current parsing, either #m_markup or the one of #m_source
+  const std::vector<RuleMarkup> *m_parse_markup;
+
+  //! The names of the marks used by the current parsing
+  const std::vector<std::string> *m_parse_mark_names;
+
+  //! Appends the semantic value of the symbol node spanning the input from begin to end
+  /** The value is enclosed in the mark, unless it is -1. Nothing is appended
+   *  for a value without markup.
+   */
+  void append_semantics(int mark, const GSS::SymbolIdent& symbol, unsigned begin, unsigned end,
+    std::vector<GSS::ValueIdent>& values);
+
+  //! Appends the XML of the events of #m_semantics from k and the text between them
+  /** Stops at the end of an alternative and returns its index. The position
+   *  is the end of the text written so far.
+   */
+  size_t write_markup(size_t k, unsigned& position, std::string& out) const;
+
+  //! The automata of the token terminals of #m_table
+  Tokenizer m_tokenizer;
+
+  //! The tokens used by the current parsing, either #m_tokenizer or the one of #m_source
+  const Tokenizer *m_parse_tokens;
+
+  //! The necessary conditions of the acceptance of a word by #m_table
+  Prefilter m_prefilter;
+
+  //! The bytes each state of #m_table has some action for, incl. the first bytes of the tokens
+  /** A token shifted into a state is not followed further if it ends before
+   *  a byte the state has no action for.
+   */
+  std::vector<std::bitset<256> > m_lookahead;
+
+  //! Fills #m_lookahead, #m_start_token and the start states for the states of #m_table
+  void compute_lookahead(void);
+
+  //! The lookahead used by the current parsing, either #m_lookahead or the one of #m_source
+  const std::vector<std::bitset<256> > *m_parse_lookahead;
+
+  //! The token column of the start symbol, -1 if the grammar is not regular
+  int m_start_token;
+
+  //! The names of the start symbols
+  std::vector<std::string> m_start_names;
+
+  //! The state the table enters from the state 0 by each start symbol
+  /** With one start symbol it is the accepting state.
+   */
+  std::vector<int> m_start_states;
+
+  //! Returns the index of #m_target_symbol in #m_start_names of the source, -1 for any
+  int find_target(const Parser *source) const;
+
+  //! Checks the start symbols of the initial state at the level
+  /** Returns true if the target generates the input up to the level, the
+   *  matched symbols and the semantic string are then set.
+   */
+  bool accept_level(const Parser *source, int target, unsigned level, const GSS::StateIdent& initial_state);
+
+  //! Parses the word of a regular grammar by the DFA of the start symbol
+  bool parse_regular(const char *word, size_t length, const Tokenizer::Dfa& dfa);
+
+  //! The word being parsed, in the caller's buffer
+  const char *m_word;
+
+  //! The length of #m_word
+  size_t m_word_length;
+
+  //! The prefixes of the word accepted by a token
+  class TokenMatch
+  {
+  public:
+    //! The end positions of the prefixes followed by a live byte
+    std::vector<unsigned> ends;
+
+    //! The position of the first byte the token cannot continue with
+    size_t stop;
+  };
+
+  //! The tokens matched by the current parsing
+  /** Indexed by the position, the column and the state the token is shifted to.
+   */
+  std::map<std::pair<std::pair<unsigned, int>, int>, TokenMatch> m_token_matches;
+
+  //! Returns the prefixes of the word from the position accepted by the token
+  /** Only the prefixes followed by a byte the new state has some action for
+   *  are returned.
+   */
+  const TokenMatch& match_token(unsigned level, int column, int new_state);
+
+  //! The tokens tried at some position, indexed by the position and the column
+  /** Contains the result of token_matches() and the stop position.
+   */
+  std::map<std::pair<unsigned, int>, std::pair<bool, size_t> > m_token_starts;
+
+  //! Returns true if the token accepts some prefix of the word from the position
+  /** The stop is set as by Tokenizer::Dfa::matches().
+   */
+  bool token_matches(unsigned level, int column, size_t& stop);
+
+  //! The pending token shifts, indexed by the level the token ends at
+  /** Each shift is represented by the shift action and the token column.
+   */
+  std::map<unsigned, std::set<std::pair<QMember, int> > > m_pending_tokens;
+
+  //! The farthest position reached by a token shifted, for the error position
+  size_t m_token_reach;
+
+  //! If set, the end of input reductions are done at every level, as a prefix may end there
+  bool m_prefix_ends;
+
+  //! If set, the reductions are done under every lookahead and nothing is shifted, see recover()
+  bool m_reduce_all;
+
+  //! Fills the table columns that may follow at the level, i.e. the next char
+  //! or end_of_input and the tokens of the state that match the word there
+  /** The tokens that would be shifted, but do not match, update #m_token_reach.
+   */
+  void get_columns(int state, unsigned level, std::vector<int>& columns);
+
+  //! Queues the shift of the column, next_q receives the char shifts
+  void queue_shift(const GSS::StateIdent& node, int new_state, unsigned level, int column,
+    std::set<QMember>& next_q);
+
+  //! Queues the actions of a state node at the level
+  /** The shifts and the zero length reductions are queued only if the node was
+   *  created. The other reductions start in the previous node, if not NULL,
+   *  the symbol node is the last symbol of the reduction.
+   */
+  void queue_actions(const GSS::StateIdent& node, int state, unsigned level,
+    const GSS::SymbolIdent& symbol, const GSS::StateIdent *previous, bool created,
+    std::set<QMember>& next_q);
+
+  //! Queues the shift of a token ending at the given position
+  void queue_token(const QMember& shift, unsigned end, int column);
+
+  //! The document of the editing session, see parse_document()
+  std::string m_document;
+
+  //! If set, the parsing keeps the #m_checkpoints for reparse()
+  bool m_keep_levels;
+
+  //! The position of the edit, the levels before it may be reused
+  size_t m_edit_position;
+
+  //! The parser whose grammar built the levels kept, NULL if none are kept
+  const Parser *m_kept_source;
+
+  //! The #m_table_version of #m_kept_source that built the levels kept
+  unsigned m_kept_version;
+
+  //! The target of the levels kept, see find_target()
+  int m_kept_target;
+
+  //! The state of the parsing before a level is shifted
+  class LevelCheckpoint
+  {
+  public:
+    //! The sizes of the gss
+    GSS::Checkpoint gss;
+
+    //! The size of #m_token_shifts
+    size_t token_shifts;
+
+    //! The number of #m_errors
+    size_t errors;
+
+    //! The #m_token_reach
+    size_t token_reach;
+
+    //! The farthest position read, std::string::npos if the level cannot be resumed
+    size_t read_reach;
+
+    LevelCheckpoint(void)
+    :token_shifts(0), errors(0), token_reach(0), read_reach(std::string::npos)
+    {}
+  };
+
+  //! The checkpoint of each level, kept if #m_keep_levels is set
+  std::vector<LevelCheckpoint> m_checkpoints;
+
+  //! A token shift queued, see #m_pending_tokens
+  class TokenShift
+  {
+  public:
+    //! The level the parsing was at
+    unsigned queued;
+
+    //! The level the token ends at
+    unsigned end;
+
+    //! The shift action
+    QMember shift;
+
+    //! The token column
+    int column;
+
+    TokenShift(unsigned _queued, unsigned _end, const QMember& _shift, int _column)
+    :queued(_queued), end(_end), shift(_shift), column(_column)
+    {}
+  };
+
+  //! The token shifts in the order they were queued, kept if #m_keep_levels is set
+  std::vector<TokenShift> m_token_shifts;
+
+  //! The longest distance from the level a token shift was queued at to its end
+  unsigned m_max_token_span;
+
+  //! The farthest position of the word read by the parsing
+  /** The levels shifted before any position after the edit was read may be
+   *  reused, see restore_levels().
+   */
+  size_t m_read_reach;
+
+  //! Parses #m_document, the levels before the position may be reused
+  bool parse_edited(size_t position);
+
+  //! Keeps the state of the parsing before the level is shifted
+  void keep_level(unsigned level);
+
+  //! Restores the state of the parsing before the last level shifted before the edit
+  /** The word must be the edited one. Returns the level the parsing
+   *  continues at, 0 if no level may be reused.
+   */
+  unsigned restore_levels(void);
+
+  //! Performs one shift action, the new state node is at the given level
+  void shift(const QMember& shift, unsigned level, int label, std::set<QMember>& next_q);
+
+  //! Performs the pending token shifts that end at the level
+  void shift_tokens(unsigned level);
   
   //! The gss used during the parsing
   GSS m_gss;
   
   //! Grammar-loading class
   AnyBnfLoad m_grammar;
+
+  //! The cache of compiled grammars
+  GrammarCache m_cache;
+
+  //! Grammars to be loaded by build_parser(), used with the cache only
+  /** Each entry contains the name of the grammar and the name of its syntax
+   *  (empty if not given).
+   */
+  std::vector<std::pair<std::string, std::string> > m_pending_grammars;
+
+  //! Set if add_referenced_grammars() is to be called by build_parser()
+  bool m_pending_references;
+
+  //! The number of #m_pending_grammars already loaded
+  unsigned m_pending_loaded;
+
+  //! Loads the grammars postponed by add_grammar()
+  void load_pending_grammars(void);
+
+  //! Computes the cache key of the grammars postponed by add_grammar()
+  std::string get_cache_key(void);
   
+  //! Returns the parser whose grammar is used, sets the tables of the current parsing
+  const Parser *select_source(void);
+
+  //! Clears the gss and the queues for a new word
+  void reset_levels(const char *word, size_t length);
+
+  //! The parsing proper, called by parse() that handles the limits
+  bool parse_levels(const char *word, size_t length);
+
+  //! Parses the levels from the given one, the levels before are parsed
+  bool parse_from(const Parser *source, int target, unsigned first);
+
+  //! The search proper, called by search() that handles the limits
+  void search_levels(const char *buffer, size_t length, std::vector<BnfParser2::Match>& matches);
+
   //! The subroutine of the parser, processes shift actions.
   /** The first parameter is the level in the gss it works in.
-   *  The second and the third parameter are the following input symbols.
+   *  The second parameter is the following input symbol.
    */  
-  void shifter(unsigned i, int a_i_plus_1, int a_i_plus_2);
+  void shifter(unsigned i, int a_i_plus_1);
 
   //! The subroutine of the parser, processes reductions.
-  /** The first parameter is the level in the gss it works in.
-   *  The second parameter is the following input symbol.
+  /** The parameter is the level in the gss it works in.
    */ 
-  void reducer(unsigned i, int a_i_plus_1);
+  void reducer(unsigned i);
   
   //! Allocates memory, loads the grammar structure and creates the GLALR(1) table.
   /** The first parameter is the grammar structure - it is a multimap; the key
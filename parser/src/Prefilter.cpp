@@ -0,0 +1,453 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "Debug.h"
+#include "Prefilter.h"
+
+//! The longest literal derived, the longer strings are not followed
+static const size_t max_literal_length = 64;
+
+//! The number of the literals kept for a nonterminal, the longest ones are kept
+static const size_t max_literals = 4;
+
+typedef std::multimap<int, std::vector<int> >::const_iterator RuleIter;
+
+//! Returns the nonterminal of the right side symbol, removes the marking
+static int unmarked(int symbol)
+{
+  return (symbol < INT_MAX / 2) ? symbol : INT_MAX - symbol;
+}
+
+//! Returns the byte with a letter converted to lower case
+static char fold(int byte)
+{
+  return static_cast<char>((byte >= 'A' && byte <= 'Z') ? byte - 'A' + 'a' : byte);
+}
+
+//! Returns the sum of two lengths
+static unsigned long add_length(unsigned long first, unsigned long second)
+{
+  return (first > Prefilter::unbounded - second) ? Prefilter::unbounded : first + second;
+}
+
+//! Returns true if the bytes at data equal the literal, ignoring the case
+static bool equal_folded(const char *data, const std::string& literal)
+{
+  for(size_t k = 0; k < literal.size(); k++)
+    if(fold(static_cast<unsigned char>(data[k])) != literal[k])
+      return false;
+  return true;
+}
+
+//! Returns true if the word contains the literal, ignoring the case
+static bool contains(const char *data, size_t length, const std::string& literal)
+{
+  if(literal.size() > length)
+    return false;
+
+  // a byte without case is searched by memchr, the rest is compared around it
+  size_t anchor = 0;
+  while(anchor < literal.size() && literal[anchor] >= 'a' && literal[anchor] <= 'z')
+    anchor++;
+
+  size_t last = length - literal.size();
+  if(anchor < literal.size())
+  {
+    const char *end = data + last + anchor + 1;
+    const char *found = data + anchor;
+    while(found < end
+      && (found = static_cast<const char*>(memchr(found, literal[anchor], end - found))) != NULL)
+    {
+      if(equal_folded(found - anchor, literal))
+        return true;
+      found++;
+    }
+    return false;
+  }
+
+  for(size_t position = 0; position <= last; position++)
+    if(equal_folded(data + position, literal))
+      return true;
+  return false;
+}
+
+//! Orders the literals by length, the longest first
+static bool longer(const std::string& first, const std::string& second)
+{
+  if(first.size() != second.size())
+    return first.size() > second.size();
+  return first < second;
+}
+
+//! Returns true if some of the literals contains the string
+static bool covered(const std::string& literal, const std::vector<std::string>& literals)
+{
+  for(size_t k = 0; k < literals.size(); k++)
+    if(literals[k].find(literal) != std::string::npos)
+      return true;
+  return false;
+}
+
+//! Drops the literals contained in other ones, keeps the longest
+static void normalize(std::vector<std::string>& literals)
+{
+  std::vector<std::string> result;
+
+  std::sort(literals.begin(), literals.end(), longer);
+  for(size_t k = 0; k < literals.size() && result.size() < max_literals; k++)
+    if(!literals[k].empty() && !covered(literals[k], result))
+      result.push_back(literals[k]);
+  literals.swap(result);
+}
+
+//! Returns the literals contained in every word containing the first or the second ones
+static std::vector<std::string> meet(const std::vector<std::string>& first,
+  const std::vector<std::string>& second)
+{
+  std::vector<std::string> result;
+
+  for(size_t k = 0; k < first.size(); k++)
+    if(covered(first[k], second))
+      result.push_back(first[k]);
+  for(size_t k = 0; k < second.size(); k++)
+    if(covered(second[k], first))
+      result.push_back(second[k]);
+  normalize(result);
+  return result;
+}
+
+const unsigned long Prefilter::unbounded;
+
+Prefilter::Prefilter(void)
+: m_min_length(0), m_max_length(unbounded)
+{
+  m_first.set();
+  m_allowed.bytes.set();
+  m_allowed.find_ranges();
+}
+
+void Prefilter::compute(const std::multimap<int, std::vector<int> >& grammar, unsigned nonterm_count)
+{
+  RuleIter rule;
+  unsigned k;
+  int nonterm;
+  bool change;
+
+  *this = Prefilter();
+  for(rule = grammar.begin(); rule != grammar.end(); rule++)
+    if(rule->first <= 0 || rule->first >= static_cast<int>(nonterm_count))
+      return;
+  if(grammar.find(1) == grammar.end())
+    return;
+
+  // the nullable nonterminals, the first bytes and the minimal lengths
+  std::vector<bool> nullable(nonterm_count, false);
+  std::vector<std::bitset<256> > first(nonterm_count);
+  std::vector<unsigned long> min_length(nonterm_count, unbounded);
+  change = true;
+  while(change)
+  {
+    change = false;
+    for(rule = grammar.begin(); rule != grammar.end(); rule++)
+    {
+      const std::vector<int>& rhs = rule->second;
+      std::bitset<256> bytes;
+      unsigned long length = 0;
+      bool empty = true;
+
+      for(k = 0; k < rhs.size(); k++)
+      {
+        if(rhs[k] <= 0)
+        {
+          if(empty)
+            bytes.set(-rhs[k]);
+          length = add_length(length, 1);
+          empty = false;
+        }
+        else
+        {
+          int symbol = unmarked(rhs[k]);
+          if(empty)
+            bytes |= first[symbol];
+          length = add_length(length, min_length[symbol]);
+          empty = empty && nullable[symbol];
+        }
+      }
+
+      if(empty && !nullable[rule->first])
+      {
+        nullable[rule->first] = true;
+        change = true;
+      }
+      if((first[rule->first] | bytes) != first[rule->first])
+      {
+        first[rule->first] |= bytes;
+        change = true;
+      }
+      if(length < min_length[rule->first])
+      {
+        min_length[rule->first] = length;
+        change = true;
+      }
+    }
+  }
+
+  // the maximal lengths, depth-first from the start, a nonterminal on a cycle is unbounded
+  std::vector<unsigned long> max_length(nonterm_count, 0);
+  std::vector<int> visit(nonterm_count, 0);  // 0 new, 1 open, 2 done
+  std::vector<std::pair<int, RuleIter> > calls;
+  std::bitset<256> allowed;
+
+  visit[1] = 1;
+  calls.push_back(std::make_pair(1, grammar.lower_bound(1)));
+  while(!calls.empty())
+  {
+    nonterm = calls.back().first;
+    RuleIter& next = calls.back().second;
+    if(next != grammar.end() && next->first == nonterm)
+    {
+      const std::vector<int>& rhs = (next++)->second;
+      for(k = 0; k < rhs.size(); k++)
+      {
+        if(rhs[k] <= 0)
+          allowed.set(-rhs[k]);
+        else if(visit[unmarked(rhs[k])] == 0)
+        {
+          visit[unmarked(rhs[k])] = 1;
+          calls.push_back(std::make_pair(unmarked(rhs[k]), grammar.lower_bound(unmarked(rhs[k]))));
+          break;
+        }
+      }
+      // the rest of the rule is visited after the nonterminal
+      if(k < rhs.size())
+        calls[calls.size() - 2].second--;
+      continue;
+    }
+
+    std::pair<RuleIter, RuleIter> rules = grammar.equal_range(nonterm);
+    for(rule = rules.first; rule != rules.second; rule++)
+    {
+      unsigned long length = 0;
+      for(k = 0; k < rule->second.size(); k++)
+      {
+        int symbol = rule->second[k];
+        if(symbol <= 0)
+          length = add_length(length, 1);
+        else if(visit[unmarked(symbol)] == 1)
+          length = unbounded;
+        else
+          length = add_length(length, max_length[unmarked(symbol)]);
+      }
+      max_length[nonterm] = std::max(max_length[nonterm], length);
+    }
+    visit[nonterm] = 2;
+    calls.pop_back();
+  }
+
+  // the nonterminals generating one word (up to the case of letters)
+  std::vector<int> exact(nonterm_count, 0);  // 0 unknown, 1 exact, 2 not exact
+  std::vector<std::string> exact_word(nonterm_count);
+  change = true;
+  while(change)
+  {
+    change = false;
+    for(nonterm = 1; nonterm < static_cast<int>(nonterm_count); nonterm++)
+    {
+      if(exact[nonterm] != 0 || visit[nonterm] != 2)
+        continue;
+
+      std::pair<RuleIter, RuleIter> rules = grammar.equal_range(nonterm);
+      std::string word;
+      bool known = true, have_word = false, single = (rules.first != rules.second);
+      for(rule = rules.first; rule != rules.second && single; rule++)
+      {
+        std::string rule_word;
+        bool rule_known = true;
+        for(k = 0; k < rule->second.size(); k++)
+        {
+          int symbol = rule->second[k];
+          if(symbol <= 0)
+            rule_word += fold(-symbol);
+          else if(exact[unmarked(symbol)] == 1)
+            rule_word += exact_word[unmarked(symbol)];
+          else if(exact[unmarked(symbol)] == 2)
+            single = false;
+          else
+            rule_known = false;
+        }
+        if(!rule_known)
+          known = false;
+        else if(rule_word.size() > max_literal_length || (have_word && rule_word != word))
+          single = false;
+        else
+        {
+          word = rule_word;
+          have_word = true;
+        }
+      }
+
+      if(!single)
+        exact[nonterm] = 2;
+      else if(known)
+      {
+        exact[nonterm] = 1;
+        exact_word[nonterm] = word;
+      }
+      else
+        continue;
+      change = true;
+    }
+  }
+
+  // the literals every word contains, starting from "any literal" for the
+  // nonterminals not yet resolved, the sets only shrink
+  std::vector<bool> resolved(nonterm_count, false);
+  std::vector<std::vector<std::string> > literals(nonterm_count);
+  change = true;
+  while(change)
+  {
+    change = false;
+    for(nonterm = 1; nonterm < static_cast<int>(nonterm_count); nonterm++)
+    {
+      if(visit[nonterm] != 2)
+        continue;
+
+      std::pair<RuleIter, RuleIter> rules = grammar.equal_range(nonterm);
+      std::vector<std::string> common;
+      bool any = true;
+      for(rule = rules.first; rule != rules.second; rule++)
+      {
+        std::vector<std::string> found;
+        std::string run;
+        bool rule_any = false;
+        for(k = 0; k < rule->second.size(); k++)
+        {
+          int symbol = rule->second[k];
+          if(symbol <= 0)
+            run += fold(-symbol);
+          else if(exact[unmarked(symbol)] == 1)
+            run += exact_word[unmarked(symbol)];
+          else
+          {
+            found.push_back(run.substr(0, max_literal_length));
+            run.clear();
+            if(!resolved[unmarked(symbol)])
+              rule_any = true;
+            else
+              found.insert(found.end(), literals[unmarked(symbol)].begin(), literals[unmarked(symbol)].end());
+          }
+        }
+        found.push_back(run.substr(0, max_literal_length));
+
+        if(rule_any)
+          continue;
+        normalize(found);
+        if(any)
+          common.swap(found);
+        else
+          common = meet(common, found);
+        any = false;
+      }
+
+      if(any)
+        continue;
+      if(resolved[nonterm])
+        common = meet(literals[nonterm], common);
+      if(!resolved[nonterm] || common != literals[nonterm])
+      {
+        resolved[nonterm] = true;
+        literals[nonterm].swap(common);
+        change = true;
+      }
+    }
+  }
+
+  m_first = first[1];
+  m_allowed.bytes = allowed;
+  m_allowed.find_ranges();
+  m_min_length = min_length[1];
+  m_max_length = max_length[1];
+  m_literals = literals[1];
+
+  logTrace(LOG_INFO, "  prefilter: " << m_first.count() << " first bytes, " << allowed.count()
+    << " bytes, length " << m_min_length << " to " << m_max_length << ", " << m_literals.size() << " literals");
+  for(k = 0; k < m_literals.size(); k++)
+    logTrace(LOG_DEBUG, "  required literal \"" << m_literals[k] << "\"");
+}
+
+bool Prefilter::check(const char *word, size_t length, size_t& position) const
+{
+  // the checks are ordered by the position they report
+  if(length != 0 && !m_first[static_cast<unsigned char>(word[0])])
+  {
+    position = 0;
+    return false;
+  }
+
+  position = Tokenizer::Dfa::skip(m_allowed, word, length, 0);
+  if(position < length || length > m_max_length)
+  {
+    position = std::min<unsigned long>(position, m_max_length);
+    return false;
+  }
+
+  position = length;
+  if(length < m_min_length)
+    return false;
+
+  for(size_t k = 0; k < m_literals.size(); k++)
+    if(!contains(word, length, m_literals[k]))
+      return false;
+
+  return true;
+}
+
+void Prefilter::write(std::ostream& out) const
+{
+  out << m_first << '\n' << m_allowed.bytes << '\n';
+  out << m_min_length << ' ' << m_max_length << ' ' << m_literals.size() << '\n';
+  for(size_t k = 0; k < m_literals.size(); k++)
+    out << m_literals[k].size() << ' ' << m_literals[k] << '\n';
+}
+
+bool Prefilter::read(std::istream& in)
+{
+  size_t literal_count, length;
+
+  m_literals.clear();
+  if(!(in >> m_first >> m_allowed.bytes >> m_min_length >> m_max_length >> literal_count))
+    return false;
+  m_allowed.find_ranges();
+
+  for(size_t k = 0; k < literal_count; k++)
+  {
+    if(!(in >> length) || in.get() != ' ' || length > max_literal_length)
+      return false;
+    std::string literal(length, '\0');
+    if(length > 0 && !in.read(&literal[0], length))
+      return false;
+    m_literals.push_back(literal);
+  }
+
+  return true;
+}
+
+// end of file
@@ -0,0 +1,88 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#ifndef _PREFILTER_
+#define _PREFILTER_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <bitset>
+#include <climits>
+
+#include "Tokenizer.h"
+
+/** \brief Necessary conditions of the acceptance, checked before the parsing.
+ *
+ *  Derived from the grammar: the bytes a word may start with, the bytes it
+ *  may contain, its minimal and maximal length and the literals every word
+ *  contains. The literals are compared ignoring the case of the letters, as
+ *  the ABNF strings are. A word failing a check cannot be accepted, so it is
+ *  rejected without any GLR parsing.
+ *
+ *  The position reported is the one of the failed check: the first byte not
+ *  allowed, the maximal length, or the end of the word when the word is too
+ *  short or lacks a literal. It is not before the position the parser would
+ *  report, but it may be after it.
+ */
+class Prefilter
+{
+public:
+  //! The maximal length of a grammar with recursion
+  static const unsigned long unbounded = ULONG_MAX;
+
+  //! Creates a filter passing all words
+  Prefilter(void);
+
+  //! Derives the conditions from the grammar, the grammar must contain the rule 1 -> start
+  void compute(const std::multimap<int, std::vector<int> >& grammar, unsigned nonterm_count);
+
+  //! Returns false if the word cannot be accepted
+  /** The position is then set to the position of the failed check.
+   */
+  bool check(const char *word, size_t length, size_t& position) const;
+
+  //! Writes the conditions to a stream
+  void write(std::ostream& out) const;
+
+  //! Reads the data written by write(), replaces compute()
+  /** Returns false if the data are not consistent.
+   */
+  bool read(std::istream& in);
+
+private:
+  //! The bytes a word may start with
+  std::bitset<256> m_first;
+
+  //! The bytes a word may contain
+  Tokenizer::Dfa::Loop m_allowed;
+
+  //! The minimal length of a word
+  unsigned long m_min_length;
+
+  //! The maximal length of a word, #unbounded if there is none
+  unsigned long m_max_length;
+
+  //! The literals every word contains, with the letters in lower case
+  std::vector<std::string> m_literals;
+};
+
+#endif  //_PREFILTER_
+
+// end of file
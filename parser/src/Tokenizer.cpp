@@ -0,0 +1,1060 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#include <set>
+#include <algorithm>
+#include <climits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Debug.h"
+#include "Tokenizer.h"
+
+//! The limits of the automata, the larger nonterminals are left to the GLR parser
+static const unsigned max_nfa_states = 20000;
+static const unsigned max_dfa_states = 1000;
+
+//! The loops with more byte ranges are skipped byte by byte
+static const unsigned max_loop_ranges = 4;
+
+//! The label of the epsilon transitions of the NFA, the bytes are 0-255
+static const int epsilon_edge = 256;
+
+//! Returns the nonterminal of the right side symbol, removes the marking
+static int unmarked(int symbol)
+{
+  return (symbol < INT_MAX / 2) ? symbol : INT_MAX - symbol;
+}
+
+/** \brief Finds the regular nonterminals and builds their automata.
+ *
+ *  The nonterminals are split into strongly connected components of the
+ *  "uses" relation. A component is right linear if its members use each other
+ *  at the end of the rules only, left linear if at the beginning only. A
+ *  nonterminal is regular if its component is right or left linear, its rules
+ *  contain no marked symbols and the nonterminals of the other components it
+ *  uses are regular.
+ */
+class RegularGrammar
+{
+public:
+  RegularGrammar(const std::multimap<int, std::vector<int> >& grammar, unsigned nonterm_count);
+
+  //! Returns true if the nonterminal derives the empty word
+  bool is_nullable(int nonterm) const
+  {
+    return m_nullable[nonterm];
+  }
+
+  //! Builds the DFAs of the regular nonterminals, except those too large
+  /** The nonterminals are processed bottom up, a nonterminal using another
+   *  one whose DFA is too large is not tried at all.
+   */
+  void build_dfas(std::map<int, Tokenizer::Dfa>& dfas);
+
+private:
+  typedef std::multimap<int, std::vector<int> >::const_iterator RuleIter;
+
+  const std::multimap<int, std::vector<int> >& m_grammar;
+
+  std::vector<bool> m_nullable;
+  std::vector<bool> m_regular;
+
+  //! The component of each nonterminal
+  std::vector<int> m_component;
+
+  //! The members of each component
+  std::vector<std::vector<int> > m_members;
+
+  //! Set for the right linear components, the others are left linear
+  std::vector<bool> m_right_linear;
+
+  //! The DFAs built so far, used instead of the NFAs of the nonterminals
+  std::map<int, Tokenizer::Dfa> *m_dfas;
+
+  //! The transitions of the NFA being built, pairs of a label and a state
+  std::vector<std::vector<std::pair<int, int> > > m_edges;
+
+  //! Fills #m_component and #m_members, the components using others come later
+  void find_components(unsigned nonterm_count);
+
+  //! Builds the DFA of a regular nonterminal, returns false if it is too large
+  bool build_dfa(int nonterm, Tokenizer::Dfa& dfa);
+
+  int add_state(void)
+  {
+    m_edges.push_back(std::vector<std::pair<int, int> >());
+    return m_edges.size() - 1;
+  }
+
+  void add_edge(int from, int label, int to)
+  {
+    m_edges[from].push_back(std::make_pair(label, to));
+  }
+
+  //! Adds the NFA of the nonterminal between the entry and the exit state
+  bool add_nonterminal(int nonterm, int entry, int exit);
+
+  //! Adds the DFA built for a nonterminal between the entry and the exit state
+  void add_dfa(const Tokenizer::Dfa& dfa, int entry, int exit);
+
+  //! Adds the NFA of the symbols [first, last) of the rule, moves the state to the end
+  bool add_sequence(const std::vector<int>& rhs, size_t first, size_t last, int& state);
+
+  //! The epsilon closures of the NFA states, computed on demand
+  std::vector<std::vector<int> > m_closures;
+
+  //! Returns the epsilon closure of the NFA state, sorted
+  const std::vector<int>& closure(int state);
+
+  //! Returns the epsilon closure of the sorted NFA states, sorted
+  std::vector<int> closure(const std::vector<int>& states);
+};
+
+RegularGrammar::RegularGrammar(const std::multimap<int, std::vector<int> >& grammar,
+  unsigned nonterm_count)
+: m_grammar(grammar), m_nullable(nonterm_count, false), m_regular(nonterm_count, false), m_dfas(NULL)
+{
+  RuleIter rule;
+  unsigned k;
+  bool change = true;
+
+  while(change)
+  {
+    change = false;
+    for(rule = m_grammar.begin(); rule != m_grammar.end(); rule++)
+    {
+      if(m_nullable[rule->first])
+        continue;
+      for(k = 0; k < rule->second.size(); k++)
+        if(rule->second[k] <= 0 || !m_nullable[unmarked(rule->second[k])])
+          break;
+      if(k == rule->second.size())
+      {
+        m_nullable[rule->first] = true;
+        change = true;
+      }
+    }
+  }
+
+  find_components(nonterm_count);
+
+  // the components used by a component are processed before it
+  for(unsigned c = 0; c < m_members.size(); c++)
+  {
+    bool regular = true, right = true, left = true;
+    for(unsigned m = 0; m < m_members[c].size() && regular; m++)
+    {
+      std::pair<RuleIter, RuleIter> rules = m_grammar.equal_range(m_members[c][m]);
+      for(rule = rules.first; rule != rules.second && regular; rule++)
+      {
+        const std::vector<int>& rhs = rule->second;
+        for(k = 0; k < rhs.size(); k++)
+        {
+          if(rhs[k] <= 0)
+            continue;
+          if(rhs[k] != unmarked(rhs[k]))
+            regular = false;
+          else if(m_component[rhs[k]] == static_cast<int>(c))
+          {
+            if(k != rhs.size() - 1)
+              right = false;
+            if(k != 0)
+              left = false;
+          }
+          else if(!m_regular[rhs[k]])
+            regular = false;
+        }
+      }
+    }
+
+    m_right_linear.push_back(right);
+    for(unsigned m = 0; m < m_members[c].size(); m++)
+      m_regular[m_members[c][m]] = regular && (right || left);
+  }
+}
+
+void RegularGrammar::find_components(unsigned nonterm_count)
+{
+  // iterative Tarjan's algorithm, the grammars may be deep
+  std::vector<std::vector<int> > successors(nonterm_count);
+  std::vector<int> index(nonterm_count, -1), lowlink(nonterm_count, 0);
+  std::vector<bool> on_stack(nonterm_count, false);
+  std::vector<int> stack;
+  std::vector<std::pair<int, unsigned> > calls;
+  int counter = 0;
+
+  for(RuleIter rule = m_grammar.begin(); rule != m_grammar.end(); rule++)
+    for(unsigned k = 0; k < rule->second.size(); k++)
+      if(rule->second[k] > 0)
+        successors[rule->first].push_back(unmarked(rule->second[k]));
+
+  m_component.assign(nonterm_count, -1);
+  for(unsigned root = 0; root < nonterm_count; root++)
+  {
+    if(index[root] != -1)
+      continue;
+
+    index[root] = lowlink[root] = counter++;
+    stack.push_back(root);
+    on_stack[root] = true;
+    calls.push_back(std::make_pair(root, 0));
+
+    while(!calls.empty())
+    {
+      int node = calls.back().first;
+      if(calls.back().second < successors[node].size())
+      {
+        int next = successors[node][calls.back().second++];
+        if(index[next] == -1)
+        {
+          index[next] = lowlink[next] = counter++;
+          stack.push_back(next);
+          on_stack[next] = true;
+          calls.push_back(std::make_pair(next, 0));
+        }
+        else if(on_stack[next])
+          lowlink[node] = std::min(lowlink[node], index[next]);
+        continue;
+      }
+
+      calls.pop_back();
+      if(!calls.empty())
+        lowlink[calls.back().first] = std::min(lowlink[calls.back().first], lowlink[node]);
+
+      if(lowlink[node] == index[node])
+      {
+        std::vector<int> members;
+        int member;
+        do
+        {
+          member = stack.back();
+          stack.pop_back();
+          on_stack[member] = false;
+          m_component[member] = m_members.size();
+          members.push_back(member);
+        }
+        while(member != node);
+        m_members.push_back(members);
+      }
+    }
+  }
+}
+
+void RegularGrammar::build_dfas(std::map<int, Tokenizer::Dfa>& dfas)
+{
+  m_dfas = &dfas;
+  for(unsigned c = 0; c < m_members.size(); c++)
+  {
+    if(!m_regular[m_members[c][0]])
+      continue;
+
+    bool complete = true;
+    for(unsigned m = 0; m < m_members[c].size() && complete; m++)
+    {
+      std::pair<RuleIter, RuleIter> rules = m_grammar.equal_range(m_members[c][m]);
+      for(RuleIter rule = rules.first; rule != rules.second && complete; rule++)
+        for(unsigned k = 0; k < rule->second.size() && complete; k++)
+        {
+          int symbol = rule->second[k];
+          if(symbol > 0 && m_component[symbol] != static_cast<int>(c) && dfas.find(symbol) == dfas.end())
+            complete = false;
+        }
+    }
+    if(!complete)
+      continue;
+
+    for(unsigned m = 0; m < m_members[c].size(); m++)
+    {
+      Tokenizer::Dfa dfa;
+      if(build_dfa(m_members[c][m], dfa))
+        dfas.insert(std::make_pair(m_members[c][m], dfa));
+    }
+  }
+  m_dfas = NULL;
+}
+
+bool RegularGrammar::add_nonterminal(int nonterm, int entry, int exit)
+{
+  int component = m_component[nonterm];
+  std::map<int, int> states;
+  std::pair<RuleIter, RuleIter> rules;
+  RuleIter rule;
+
+  if(m_right_linear[component])
+  {
+    // states[X] starts X, the members are used at the end of the rules
+    std::vector<int> pending(1, nonterm);
+    states[nonterm] = add_state();
+    add_edge(entry, epsilon_edge, states[nonterm]);
+
+    while(!pending.empty())
+    {
+      int member = pending.back();
+      pending.pop_back();
+
+      rules = m_grammar.equal_range(member);
+      for(rule = rules.first; rule != rules.second; rule++)
+      {
+        const std::vector<int>& rhs = rule->second;
+        int state = states[member];
+        bool tail = !rhs.empty() && rhs.back() > 0 && m_component[rhs.back()] == component;
+
+        if(!add_sequence(rhs, 0, tail ? rhs.size() - 1 : rhs.size(), state))
+          return false;
+
+        if(tail)
+        {
+          if(states.find(rhs.back()) == states.end())
+          {
+            states[rhs.back()] = add_state();
+            pending.push_back(rhs.back());
+          }
+          add_edge(state, epsilon_edge, states[rhs.back()]);
+        }
+        else
+          add_edge(state, epsilon_edge, exit);
+      }
+    }
+  }
+  else
+  {
+    // states[X] follows X, the members are used at the beginning of the rules
+    const std::vector<int>& members = m_members[component];
+    for(unsigned m = 0; m < members.size(); m++)
+      states[members[m]] = add_state();
+
+    for(unsigned m = 0; m < members.size(); m++)
+    {
+      rules = m_grammar.equal_range(members[m]);
+      for(rule = rules.first; rule != rules.second; rule++)
+      {
+        const std::vector<int>& rhs = rule->second;
+        bool head = !rhs.empty() && rhs.front() > 0 && m_component[rhs.front()] == component;
+        int state = head ? states[rhs.front()] : entry;
+
+        if(!add_sequence(rhs, head ? 1 : 0, rhs.size(), state))
+          return false;
+        add_edge(state, epsilon_edge, states[members[m]]);
+      }
+    }
+    add_edge(states[nonterm], epsilon_edge, exit);
+  }
+
+  return m_edges.size() <= max_nfa_states;
+}
+
+void RegularGrammar::add_dfa(const Tokenizer::Dfa& dfa, int entry, int exit)
+{
+  int first = m_edges.size();
+  unsigned state, byte;
+
+  for(state = 0; state < dfa.accepting.size(); state++)
+    add_state();
+  add_edge(entry, epsilon_edge, first);
+
+  for(state = 0; state < dfa.accepting.size(); state++)
+  {
+    for(byte = 0; byte < 256; byte++)
+    {
+      int next = dfa.next[state * dfa.class_count + dfa.classes[byte]];
+      if(next != -1)
+        add_edge(first + state, byte, first + next);
+    }
+    if(dfa.accepting[state])
+      add_edge(first + state, epsilon_edge, exit);
+  }
+}
+
+bool RegularGrammar::add_sequence(const std::vector<int>& rhs, size_t first, size_t last, int& state)
+{
+  std::map<int, Tokenizer::Dfa>::const_iterator dfa;
+
+  for(size_t k = first; k < last; k++)
+  {
+    int next = add_state();
+    if(rhs[k] <= 0)
+      add_edge(state, -rhs[k], next);
+    // the DFA is usually much smaller than the NFA
+    else if(m_dfas != NULL && (dfa = m_dfas->find(rhs[k])) != m_dfas->end())
+      add_dfa(dfa->second, state, next);
+    else if(!add_nonterminal(rhs[k], state, next))
+      return false;
+    state = next;
+
+    if(m_edges.size() > max_nfa_states)
+      return false;
+  }
+  return true;
+}
+
+const std::vector<int>& RegularGrammar::closure(int state)
+{
+  std::vector<int>& result = m_closures[state];
+  if(!result.empty())
+    return result;
+
+  std::set<int> states;
+  std::vector<int> pending(1, state);
+  states.insert(state);
+  while(!pending.empty())
+  {
+    int current = pending.back();
+    pending.pop_back();
+    for(unsigned k = 0; k < m_edges[current].size(); k++)
+      if(m_edges[current][k].first == epsilon_edge && states.insert(m_edges[current][k].second).second)
+        pending.push_back(m_edges[current][k].second);
+  }
+
+  result.assign(states.begin(), states.end());
+  return result;
+}
+
+std::vector<int> RegularGrammar::closure(const std::vector<int>& states)
+{
+  std::vector<int> result;
+  for(unsigned k = 0; k < states.size(); k++)
+  {
+    const std::vector<int>& part = closure(states[k]);
+    result.insert(result.end(), part.begin(), part.end());
+  }
+
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+bool RegularGrammar::build_dfa(int nonterm, Tokenizer::Dfa& dfa)
+{
+  m_edges.clear();
+  int entry = add_state();
+  int exit = add_state();
+  if(!add_nonterminal(nonterm, entry, exit))
+    return false;
+  m_closures.assign(m_edges.size(), std::vector<int>());
+
+  // the bytes used by the same transitions form a class
+  std::vector<std::vector<int> > signatures(256);
+  std::map<std::vector<int>, unsigned> class_ids;
+  int edge_id = 0;
+  for(unsigned state = 0; state < m_edges.size(); state++)
+    for(unsigned k = 0; k < m_edges[state].size(); k++, edge_id++)
+      if(m_edges[state][k].first != epsilon_edge)
+        signatures[m_edges[state][k].first].push_back(edge_id);
+  for(unsigned byte = 0; byte < 256; byte++)
+  {
+    unsigned id = class_ids.size();
+    dfa.classes[byte] = class_ids.insert(std::make_pair(signatures[byte], id)).first->second;
+  }
+  dfa.class_count = class_ids.size();
+
+  // subset construction
+  std::map<std::vector<int>, int> dfa_states;
+  std::vector<std::vector<int> > subsets;
+  subsets.push_back(closure(std::vector<int>(1, entry)));
+  dfa_states[subsets.back()] = 0;
+
+  for(unsigned current = 0; current < subsets.size(); current++)
+  {
+    std::vector<int> subset = subsets[current];
+    std::vector<std::vector<int> > targets(dfa.class_count);
+    for(unsigned s = 0; s < subset.size(); s++)
+      for(unsigned k = 0; k < m_edges[subset[s]].size(); k++)
+        if(m_edges[subset[s]][k].first != epsilon_edge)
+          targets[dfa.classes[m_edges[subset[s]][k].first]].push_back(m_edges[subset[s]][k].second);
+
+    for(unsigned c = 0; c < dfa.class_count; c++)
+    {
+      if(targets[c].empty())
+      {
+        dfa.next.push_back(-1);
+        continue;
+      }
+
+      std::sort(targets[c].begin(), targets[c].end());
+      targets[c].erase(std::unique(targets[c].begin(), targets[c].end()), targets[c].end());
+      std::vector<int> target = closure(targets[c]);
+      std::map<std::vector<int>, int>::iterator found = dfa_states.find(target);
+      if(found == dfa_states.end())
+      {
+        if(subsets.size() >= max_dfa_states)
+          return false;
+        found = dfa_states.insert(std::make_pair(target, static_cast<int>(subsets.size()))).first;
+        subsets.push_back(target);
+      }
+      dfa.next.push_back(found->second);
+    }
+    dfa.accepting.push_back(std::binary_search(subset.begin(), subset.end(), exit));
+  }
+
+  // the states that cannot reach an accepting state are dropped too
+  dfa.minimize();
+  dfa.find_loops();
+
+  logTrace(LOG_DEBUG, "  token " << nonterm << ": " << m_edges.size() << " NFA states, "
+    << dfa.accepting.size() << " DFA states, " << dfa.class_count << " byte classes");
+  return true;
+}
+
+void Tokenizer::Dfa::minimize(void)
+{
+  const int sink = accepting.size();
+  const unsigned count = sink + 1;
+  unsigned c, k;
+  int state;
+
+  // the predecessors of each state by each class, the sink makes the DFA complete
+  std::vector<std::vector<int> > inverse(count * class_count);
+  for(state = 0; state < sink; state++)
+    for(c = 0; c < class_count; c++)
+    {
+      int target = next[state * class_count + c];
+      inverse[((target == -1) ? sink : target) * class_count + c].push_back(state);
+    }
+  for(c = 0; c < class_count; c++)
+    inverse[sink * class_count + c].push_back(sink);
+
+  std::vector<int> block_of(count);
+  std::vector<std::vector<int> > blocks(2);
+  for(state = 0; state < static_cast<int>(count); state++)
+  {
+    block_of[state] = (state != sink && accepting[state]) ? 0 : 1;
+    blocks[block_of[state]].push_back(state);
+  }
+
+  if(blocks[0].empty())
+  {
+    next.assign(class_count, -1);
+    accepting.assign(1, false);
+    return;
+  }
+
+  // Hopcroft's algorithm, the splitters are pairs of a block and a class
+  std::vector<std::pair<int, unsigned> > pending;
+  std::vector<bool> waiting(2 * class_count, false);
+  int smaller = (blocks[0].size() <= blocks[1].size()) ? 0 : 1;
+  for(c = 0; c < class_count; c++)
+  {
+    pending.push_back(std::make_pair(smaller, c));
+    waiting[smaller * class_count + c] = true;
+  }
+
+  while(!pending.empty())
+  {
+    std::pair<int, unsigned> splitter = pending.back();
+    pending.pop_back();
+    waiting[splitter.first * class_count + splitter.second] = false;
+
+    // the states going to the splitter block, by their block
+    std::map<int, std::vector<int> > touched;
+    const std::vector<int>& members = blocks[splitter.first];
+    for(k = 0; k < members.size(); k++)
+    {
+      const std::vector<int>& sources = inverse[members[k] * class_count + splitter.second];
+      for(unsigned l = 0; l < sources.size(); l++)
+        touched[block_of[sources[l]]].push_back(sources[l]);
+    }
+
+    for(std::map<int, std::vector<int> >::iterator pos = touched.begin(); pos != touched.end(); pos++)
+    {
+      int block = pos->first;
+      if(pos->second.size() == blocks[block].size())
+        continue;
+
+      int split = blocks.size();
+      blocks.push_back(pos->second);
+      for(k = 0; k < pos->second.size(); k++)
+        block_of[pos->second[k]] = split;
+
+      std::vector<int> rest;
+      for(k = 0; k < blocks[block].size(); k++)
+        if(block_of[blocks[block][k]] == block)
+          rest.push_back(blocks[block][k]);
+      blocks[block].swap(rest);
+
+      waiting.resize(blocks.size() * class_count, false);
+      for(c = 0; c < class_count; c++)
+      {
+        int added = split;
+        if(!waiting[block * class_count + c] && blocks[block].size() < blocks[split].size())
+          added = block;
+        pending.push_back(std::make_pair(added, c));
+        waiting[added * class_count + c] = true;
+      }
+    }
+  }
+
+  // the block of the initial state becomes the state 0, the block of the sink is dropped
+  std::vector<int> number(blocks.size(), -1);
+  int dead = block_of[sink];
+  int block_count = 0;
+  number[block_of[0]] = block_count++;
+  for(k = 0; k < blocks.size(); k++)
+    if(static_cast<int>(k) != dead && number[k] == -1)
+      number[k] = block_count++;
+
+  std::vector<int> new_next(block_count * class_count);
+  std::vector<bool> new_accepting(block_count);
+  for(k = 0; k < blocks.size(); k++)
+  {
+    if(number[k] == -1)
+      continue;
+
+    int first = blocks[k].front();
+    for(c = 0; c < class_count; c++)
+    {
+      int target = next[first * class_count + c];
+      new_next[number[k] * class_count + c] =
+        (target == -1 || block_of[target] == dead) ? -1 : number[block_of[target]];
+    }
+    new_accepting[number[k]] = accepting[first];
+  }
+
+  next.swap(new_next);
+  accepting.swap(new_accepting);
+}
+
+void Tokenizer::Dfa::find_loops(void)
+{
+  loops.assign(accepting.size(), -1);
+  loop_sets.clear();
+
+  for(unsigned state = 0; state < accepting.size(); state++)
+  {
+    Loop loop;
+    for(unsigned byte = 0; byte < 256; byte++)
+      if(next[state * class_count + classes[byte]] == static_cast<int>(state))
+        loop.bytes.set(byte);
+    if(loop.bytes.none())
+      continue;
+
+    unsigned k;
+    for(k = 0; k < loop_sets.size(); k++)
+      if(loop_sets[k].bytes == loop.bytes)
+        break;
+
+    if(k == loop_sets.size())
+    {
+      loop.find_ranges();
+      loop_sets.push_back(loop);
+    }
+    loops[state] = k;
+  }
+}
+
+void Tokenizer::Dfa::Loop::find_ranges(void)
+{
+  ranges.clear();
+  for(unsigned byte = 0; byte < 256; byte++)
+  {
+    if(!bytes[byte])
+      continue;
+    if(!ranges.empty() && ranges.back().second == byte - 1)
+      ranges.back().second = byte;
+    else
+      ranges.push_back(std::make_pair(byte, byte));
+  }
+  if(ranges.size() > max_loop_ranges)
+    ranges.clear();
+}
+
+size_t Tokenizer::Dfa::skip(const Loop& loop, const char *word, size_t length, size_t start)
+{
+  const unsigned char *data = reinterpret_cast<const unsigned char*>(word);
+  size_t position = start;
+
+#ifdef __SSE2__
+  // 16 bytes at once, x is in the range iff min(x - first, last - first) == x - first
+  if(!loop.ranges.empty())
+  {
+    while(position + 16 <= length)
+    {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+      __m128i found = _mm_setzero_si128();
+      for(unsigned k = 0; k < loop.ranges.size(); k++)
+      {
+        __m128i offset = _mm_sub_epi8(block, _mm_set1_epi8(static_cast<char>(loop.ranges[k].first)));
+        __m128i width = _mm_set1_epi8(static_cast<char>(loop.ranges[k].second - loop.ranges[k].first));
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(_mm_min_epu8(offset, width), offset));
+      }
+      if(_mm_movemask_epi8(found) != 0xFFFF)
+        break;
+      position += 16;
+    }
+  }
+#endif
+
+  while(position < length && loop.bytes[data[position]])
+    position++;
+  return position;
+}
+
+size_t Tokenizer::Dfa::match(const char *word, size_t length, size_t start,
+  const std::bitset<256>& live, std::vector<unsigned>& ends) const
+{
+  int state = 0;
+  size_t position = start;
+
+  while(position < length)
+  {
+    state = next[state * class_count + classes[static_cast<unsigned char>(word[position])]];
+    if(state == -1)
+      break;
+    position++;
+
+    // inside the run the next byte is a loop byte, so the end is not live
+    int loop = loops[state];
+    if(loop != -1 && (!accepting[state] || (loop_sets[loop].bytes & live).none()))
+      position = skip(loop_sets[loop], word, length, position);
+
+    if(accepting[state]
+      && (position == length || live[static_cast<unsigned char>(word[position])]))
+      ends.push_back(position);
+  }
+
+  return position;
+}
+
+bool Tokenizer::Dfa::accepts(const char *word, size_t length, size_t& stop) const
+{
+  int state = 0;
+  size_t position = 0;
+
+  while(position < length)
+  {
+    state = next[state * class_count + classes[static_cast<unsigned char>(word[position])]];
+    if(state == -1)
+    {
+      stop = position;
+      return false;
+    }
+    position++;
+
+    if(loops[state] != -1)
+      position = skip(loop_sets[loops[state]], word, length, position);
+  }
+
+  stop = position;
+  return accepting[state];
+}
+
+void Tokenizer::Dfa::accepts(const std::vector<std::string>& words, std::vector<bool>& accepted,
+  std::vector<size_t>& stops) const
+{
+  // the word, the position and the state of each lane
+  size_t word[lanes];
+  size_t position[lanes];
+  int state[lanes];
+  unsigned active = 0;
+  size_t taken = 0;
+
+  accepted.assign(words.size(), false);
+  stops.assign(words.size(), 0);
+
+  for(unsigned lane = 0; lane < lanes && taken < words.size(); lane++, taken++)
+  {
+    word[active] = taken;
+    position[active] = 0;
+    state[active] = 0;
+    active++;
+  }
+
+  while(active > 0)
+  {
+    for(unsigned lane = 0; lane < active; /**/)
+    {
+      const std::string& current = words[word[lane]];
+      bool finished;
+
+      if(position[lane] < current.size())
+      {
+        int next_state =
+          next[state[lane] * class_count + classes[static_cast<unsigned char>(current[position[lane]])]];
+        if(next_state == -1)
+          finished = true;
+        else
+        {
+          state[lane] = next_state;
+          position[lane]++;
+          if(loops[next_state] != -1)
+            position[lane] = skip(loop_sets[loops[next_state]], current.data(), current.size(),
+              position[lane]);
+          finished = false;
+        }
+      }
+      else
+      {
+        accepted[word[lane]] = accepting[state[lane]];
+        finished = true;
+      }
+
+      if(!finished)
+      {
+        lane++;
+        continue;
+      }
+
+      stops[word[lane]] = position[lane];
+      // the lane takes the next word, or the last lane moves here
+      if(taken < words.size())
+      {
+        word[lane] = taken++;
+        position[lane] = 0;
+        state[lane] = 0;
+      }
+      else
+      {
+        active--;
+        word[lane] = word[active];
+        position[lane] = position[active];
+        state[lane] = state[active];
+      }
+    }
+  }
+}
+
+bool Tokenizer::Dfa::matches(const char *word, size_t length, size_t start, size_t& stop) const
+{
+  int state = 0;
+  size_t position = start;
+
+  while(position < length)
+  {
+    state = next[state * class_count + classes[static_cast<unsigned char>(word[position])]];
+    if(state == -1)
+    {
+      stop = position;
+      return false;
+    }
+    if(accepting[state])
+    {
+      stop = position;
+      return true;
+    }
+    position++;
+
+    if(loops[state] != -1)
+      position = skip(loop_sets[loops[state]], word, length, position);
+  }
+
+  stop = position;
+  return false;
+}
+
+void Tokenizer::compile(const std::multimap<int, std::vector<int> >& grammar, unsigned nonterm_count,
+  std::multimap<int, std::vector<int> >& result)
+{
+  std::multimap<int, std::vector<int> >::const_iterator rule;
+  unsigned k;
+
+  // the tokens of the previous grammar keep their numbers and the kept
+  // nonterminals are not turned into tokens, see LalrTable::update()
+  std::vector<int> previous;
+  std::set<int> previous_kept;
+  previous.swap(m_nonterminals);
+  previous_kept.swap(m_kept);
+  m_dfas.clear();
+  result.clear();
+
+  for(rule = grammar.begin(); rule != grammar.end(); rule++)
+    if(rule->first <= 0 || rule->first >= static_cast<int>(nonterm_count))
+      break;
+
+  if(!m_enabled || rule != grammar.end())
+  {
+    result = grammar;
+    return;
+  }
+
+  RegularGrammar regular(grammar, nonterm_count);
+
+  // the nonterminals used by the start symbol, either kept or tokens
+  enum { unknown, kept, token };
+  std::vector<int> kind(nonterm_count, unknown);
+  std::map<int, Dfa> dfas;
+  regular.build_dfas(dfas);
+  std::vector<int> pending(1, 1);
+  kind[1] = kept;
+
+  while(!pending.empty())
+  {
+    std::pair<std::multimap<int, std::vector<int> >::const_iterator,
+      std::multimap<int, std::vector<int> >::const_iterator> rules = grammar.equal_range(pending.back());
+    pending.pop_back();
+
+    for(rule = rules.first; rule != rules.second; rule++)
+    {
+      for(k = 0; k < rule->second.size(); k++)
+      {
+        if(rule->second[k] <= 0)
+          continue;
+
+        int nonterm = unmarked(rule->second[k]);
+        if(kind[nonterm] != unknown)
+          continue;
+
+        if(dfas.find(nonterm) != dfas.end() && previous_kept.find(nonterm) == previous_kept.end())
+          kind[nonterm] = token;
+        else
+        {
+          kind[nonterm] = kept;
+          pending.push_back(nonterm);
+        }
+      }
+    }
+  }
+
+  for(k = 0; k < previous.size(); k++)
+  {
+    int nonterm = (previous[k] < 0) ? -1 - previous[k] : previous[k];
+    if(nonterm >= static_cast<int>(nonterm_count))
+      break;
+
+    if(previous[k] >= 0 && kind[nonterm] == token)
+    {
+      m_nonterminals.push_back(nonterm);
+      m_dfas.push_back(dfas[nonterm]);
+      continue;
+    }
+
+    // the token of a nonterminal that is not regular anymore matches nothing,
+    // its rule stays in the grammar, so that the table may be updated
+    Dfa dead;
+    dead.next.assign(1, -1);
+    dead.accepting.assign(1, false);
+    dead.find_loops();
+    m_nonterminals.push_back(-1 - nonterm);
+    m_dfas.push_back(dead);
+    result.insert(std::make_pair(nonterm, std::vector<int>(1, -257 - static_cast<int>(k))));
+  }
+
+  // the DFAs of the nonterminals used by the tokens only are dropped
+  for(std::map<int, Dfa>::iterator pos = dfas.begin(); pos != dfas.end(); pos++)
+  {
+    if(kind[pos->first] != token
+      || std::find(previous.begin(), previous.end(), pos->first) != previous.end())
+      continue;
+    m_nonterminals.push_back(pos->first);
+    m_dfas.push_back(pos->second);
+  }
+
+  for(rule = grammar.begin(); rule != grammar.end(); rule++)
+    if(kind[rule->first] == kept)
+      result.insert(*rule);
+
+  for(k = 0; k < nonterm_count; k++)
+    if(kind[k] == kept)
+      m_kept.insert(k);
+
+  for(k = 0; k < m_nonterminals.size(); k++)
+  {
+    if(m_nonterminals[k] < 0)
+      continue;
+    result.insert(std::make_pair(m_nonterminals[k], std::vector<int>(1, -257 - static_cast<int>(k))));
+    if(regular.is_nullable(m_nonterminals[k]))
+      result.insert(std::make_pair(m_nonterminals[k], std::vector<int>()));
+  }
+
+  logTrace(LOG_INFO, "  " << m_dfas.size() << " regular nonterminals compiled to tokens");
+}
+
+void Tokenizer::write(std::ostream& out) const
+{
+  unsigned k;
+
+  out << m_dfas.size() << '\n';
+  for(unsigned t = 0; t < m_dfas.size(); t++)
+  {
+    const Dfa& dfa = m_dfas[t];
+    out << m_nonterminals[t] << ' ' << dfa.class_count << ' ' << dfa.accepting.size() << '\n';
+    for(k = 0; k < dfa.classes.size(); k++)
+      out << static_cast<unsigned>(dfa.classes[k]) << ' ';
+    out << '\n';
+    for(k = 0; k < dfa.next.size(); k++)
+      out << dfa.next[k] << ' ';
+    out << '\n';
+    for(k = 0; k < dfa.accepting.size(); k++)
+      out << dfa.accepting[k] << ' ';
+    out << '\n';
+  }
+
+  out << m_kept.size() << '\n';
+  for(std::set<int>::const_iterator pos = m_kept.begin(); pos != m_kept.end(); pos++)
+    out << *pos << ' ';
+  out << '\n';
+}
+
+bool Tokenizer::read(std::istream& in)
+{
+  size_t token_count, state_count;
+  unsigned k, value;
+
+  m_nonterminals.clear();
+  m_dfas.clear();
+  m_kept.clear();
+
+  if(!(in >> token_count))
+    return false;
+  for(unsigned t = 0; t < token_count; t++)
+  {
+    int nonterm;
+    Dfa dfa;
+    if(!(in >> nonterm >> dfa.class_count >> state_count) || dfa.class_count == 0 || dfa.class_count > 256)
+      return false;
+
+    for(k = 0; k < 256; k++)
+    {
+      if(!(in >> value) || value >= dfa.class_count)
+        return false;
+      dfa.classes[k] = value;
+    }
+
+    dfa.next.resize(state_count * dfa.class_count);
+    for(k = 0; k < dfa.next.size(); k++)
+      if(!(in >> dfa.next[k]) || dfa.next[k] < -1 || dfa.next[k] >= static_cast<int>(state_count))
+        return false;
+
+    dfa.accepting.resize(state_count);
+    for(k = 0; k < state_count; k++)
+    {
+      if(!(in >> value))
+        return false;
+      dfa.accepting[k] = (value != 0);
+    }
+
+    dfa.find_loops();
+    m_nonterminals.push_back(nonterm);
+    m_dfas.push_back(dfa);
+  }
+
+  size_t kept_count;
+  if(!(in >> kept_count))
+    return false;
+  for(k = 0; k < kept_count; k++)
+  {
+    int nonterm;
+    if(!(in >> nonterm))
+      return false;
+    m_kept.insert(nonterm);
+  }
+
+  return true;
+}
+
+// end of file
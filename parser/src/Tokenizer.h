@@ -0,0 +1,211 @@
+/*
+ * bnfparser2 - Generic BNF-adaptable parser
+ * http://bnfparser2.sourceforge.net
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License version 2.1, as published by the Free Software Foundation.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ * Copyright (c) 2007 ANF DATA spol. s r.o.
+ *
+ * $Id$
+ */
+
+#ifndef _TOKENIZER_
+#define _TOKENIZER_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <bitset>
+
+/** \brief Lexical analysis of the regular parts of the grammar.
+ *
+ *  Many nonterminals, e.g. token or IPv4address, generate a regular language.
+ *  Parsed by the GLR parser, each byte of them creates a level of the gss and
+ *  several reductions. The tokenizer finds the maximal regular nonterminals,
+ *  i.e. the nonterminals that do not use the rest of the grammar, are left or
+ *  right recursive only and contain no marked nonterminals, and compiles each
+ *  of them to a DFA.
+ *
+ *  In the grammar given to the LalrTable, each such nonterminal N has the rule
+ *  N -> T only (and N -> epsilon when N is nullable), where T is a token
+ *  terminal. The parser shifts T over every prefix of the remaining input the
+ *  DFA accepts, so no parse is lost, and the levels inside the token are not
+ *  processed at all. The semantic value of N does not change: a nonterminal
+ *  without marks yields the input it spans.
+ *
+ *  The token terminal number t is represented by the symbol -257-t, i.e. the
+ *  table column 257+t.
+ *
+ *  When the start symbol itself is regular, the whole word is recognized by
+ *  its DFA and the GLR parser is not used at all.
+ */
+class Tokenizer
+{
+public:
+  //! The DFA recognizing one token
+  class Dfa
+  {
+  public:
+    //! The class of each byte, the bytes of one class have the same transitions
+    std::vector<unsigned char> classes;
+
+    //! The number of the byte classes
+    unsigned class_count;
+
+    //! The transitions, next[state*class_count + class], -1 if the token cannot continue
+    std::vector<int> next;
+
+    //! The accepting states
+    std::vector<bool> accepting;
+
+    //! The bytes a state loops on, e.g. the bytes of *DIGIT
+    class Loop
+    {
+    public:
+      std::bitset<256> bytes;
+
+      //! The bytes as ranges of the first and the last byte, empty if too many
+      std::vector<std::pair<unsigned char, unsigned char> > ranges;
+
+      //! Fills #ranges from #bytes
+      void find_ranges(void);
+    };
+
+    //! The loop of each state, the index to #loop_sets or -1
+    std::vector<int> loops;
+
+    //! The distinct loops
+    std::vector<Loop> loop_sets;
+
+    Dfa(void)
+    : classes(256, 0), class_count(1)
+    {}
+
+    //! Merges the equivalent states, drops the states that cannot reach an accepting state
+    void minimize(void);
+
+    //! Fills #loops and #loop_sets, called when the transitions are complete
+    void find_loops(void);
+
+    //! Returns true if the DFA accepts the whole word
+    /** The stop is set to the position of the first byte the DFA cannot
+     *  continue with, or to the length of the word.
+     */
+    bool accepts(const char *word, size_t length, size_t& stop) const;
+
+    //! The number of the words the batch accepts() runs in lockstep
+    static const unsigned lanes = 8;
+
+    //! Runs accepts() on each of the words
+    /** The words are run in #lanes interleaved lanes; a lane that finishes
+     *  takes the next word. The transitions of the lanes are independent, so
+     *  the loads of the table overlap instead of waiting for each other.
+     */
+    void accepts(const std::vector<std::string>& words, std::vector<bool>& accepted,
+      std::vector<size_t>& stops) const;
+
+    //! Runs the DFA on the word from the given position
+    /** Appends the end positions of the accepted prefixes followed by a live
+     *  byte (or by the end of the word) to ends. The runs of a looping state
+     *  are skipped at once when no position inside them may be an end.
+     *  Returns the position of the first byte the token cannot continue with,
+     *  i.e. how far a byte by byte parser would get.
+     */
+    size_t match(const char *word, size_t length, size_t start, const std::bitset<256>& live,
+      std::vector<unsigned>& ends) const;
+
+    //! Returns true if some prefix of the word from the given position is accepted
+    /** If so, the stop is set to the last byte of the shortest such prefix.
+     *  If not, it is set to the position of the first byte the DFA cannot
+     *  continue with, or to the length of the word.
+     */
+    bool matches(const char *word, size_t length, size_t start, size_t& stop) const;
+
+    //! Returns the position of the first byte after start not in the loop
+    static size_t skip(const Loop& loop, const char *word, size_t length, size_t start);
+  };
+
+  Tokenizer(void)
+  : m_enabled(true)
+  {}
+
+  //! Enables or disables the tokens, compile() then returns the grammar unchanged
+  void set_enabled(bool enabled)
+  {
+    m_enabled = enabled;
+  }
+
+  //! Returns true if the tokens are enabled
+  bool enabled(void) const
+  {
+    return m_enabled;
+  }
+
+  //! Finds the tokens of the grammar and compiles them
+  /** The grammar must contain the rule 1 -> start. Fills the result with the
+   *  grammar for the LalrTable, which uses the token terminals.
+   *  When called again for a grammar with more rules, the tokens found before
+   *  keep their numbers and the new ones are appended, so the rules given to
+   *  the table before remain, see LalrTable::update().
+   */
+  void compile(const std::multimap<int, std::vector<int> >& grammar, unsigned nonterm_count,
+    std::multimap<int, std::vector<int> >& result);
+
+  //! Returns the number of the token terminals
+  unsigned get_token_count(void) const
+  {
+    return m_dfas.size();
+  }
+
+  //! Returns the DFA of the token terminal with the given table column
+  const Dfa& get_dfa(int column) const
+  {
+    return m_dfas[column - 257];
+  }
+
+  //! Returns the table column of the token of the nonterminal, -1 if it is not a token
+  int get_column(int nonterm) const
+  {
+    for(unsigned t = 0; t < m_nonterminals.size(); t++)
+      if(m_nonterminals[t] == nonterm)
+        return 257 + t;
+    return -1;
+  }
+
+  //! Writes the DFAs to a stream
+  void write(std::ostream& out) const;
+
+  //! Reads the data written by write(), replaces compile()
+  /** Returns false if the data are not consistent.
+   */
+  bool read(std::istream& in);
+
+private:
+  //! If not set, no tokens are used
+  bool m_enabled;
+
+  //! The nonterminal of each token
+  /** A nonterminal that is not regular anymore is stored as -1 - nonterminal,
+   *  its token keeps the number, but matches nothing, see compile().
+   */
+  std::vector<int> m_nonterminals;
+
+  //! The DFA of each token
+  std::vector<Dfa> m_dfas;
+
+  //! The nonterminals whose rules are passed to the table, never made tokens later
+  std::set<int> m_kept;
+};
+
+#endif  //_TOKENIZER_
+
+// end of file